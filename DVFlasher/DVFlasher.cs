@@ -39,13 +39,16 @@ namespace DVFlasher
         UBL_MAGIC_DMA_IC = 0xA1ACED44,	            /* DMA + ICache boot mode */
         UBL_MAGIC_DMA_IC_FAST = 0xA1ACED55,	        /* DMA + ICache + Fast EMIF boot mode */
         UBL_MAGIC_BIN_IMG = 0xA1ACED66,             /* Describes the application image in Flash - indicates that it is binary*/
+        UBL_MAGIC_XIP_IMG = 0xA1ACEDEE,             /* Describes the application image in Flash - binary, executed in place from NOR */
         UBL_MAGIC_NOR_RESTORE = 0xA1ACED77,         /* Download via UART & Restore NOR with binary data */
         UBL_MAGIC_NOR_SREC_BURN = 0xA1ACED88,       /* Download via UART & Burn NOR with UBL readable header and SREC data*/
         UBL_MAGIC_NOR_BIN_BURN = 0xA1ACED99,        /* Download via UART & Burn NOR with UBL readable header and BIN data */
         UBL_MAGIC_NOR_GLOBAL_ERASE = 0xA1ACEDAA,    /* Download via UART & Global erase the NOR Flash */
         UBL_MAGIC_NAND_SREC_BURN = 0xA1ACEDBB,   /* Download via UART & Burn NAND - Image is S-record */
         UBL_MAGIC_NAND_BIN_BURN = 0xA1ACEDCC,   /* Download via UART & Burn NAND - Image is binary */
-        UBL_MAGIC_NAND_GLOBAL_ERASE = 0xA1ACEDDD	/* Download via UART & Global erase the NAND Flash */
+        UBL_MAGIC_NAND_GLOBAL_ERASE = 0xA1ACEDDD,	/* Download via UART & Global erase the NAND Flash */
+        UBL_MAGIC_DUMP = 0xA1ACED10,                /* Read a block range of the flash back via UART */
+        UBL_MAGIC_VERIFY = 0xA1ACED20               /* Check a block range of the flash against CRCs sent via UART */
     };
     
     /// <summary>
@@ -58,6 +61,25 @@ namespace DVFlasher
         NAND
     };
 
+    /// <summary>
+    /// Header describing an image sent to the UBL (UART_ACK_HEADER)
+    /// </summary>
+    struct ImageHeader
+    {
+        public UInt32 MagicNum;
+        public UInt32 EntryPoint;
+        public UInt32 ByteCount;
+        public UInt32 Flags;
+
+        public ImageHeader(UInt32 magicNum, UInt32 entryPoint, UInt32 byteCount, UInt32 flags)
+        {
+            MagicNum = magicNum;
+            EntryPoint = entryPoint;
+            ByteCount = byteCount;
+            Flags = flags;
+        }
+    }
+
     /// <summary>
     /// Structure to hold command parameters
     /// </summary>
@@ -154,6 +176,51 @@ namespace DVFlasher
         /// Address where the app begin execution 
         /// </summary>
         public UInt32 APPEntryPoint;
+
+        /// <summary>
+        /// First flash block and number of blocks (0 = to the end) to read back
+        /// </summary>
+        public UInt32 DumpStartBlock;
+        public UInt32 DumpNumBlocks;
+
+        /// <summary>
+        /// Whether the UBL may leave erased pages out of a dump
+        /// </summary>
+        public Boolean DumpCompress;
+
+        /// <summary>
+        /// Number of bytes handed to the serial port per write when sending an image
+        /// </summary>
+        public Int32 WriteChunkSize;
+
+        /// <summary>
+        /// Use RTS/CTS hardware handshaking (UBL built with FLOW=rtscts) once
+        /// the UART UBL is running; the ROM stage is always without it
+        /// </summary>
+        public Boolean HWFlowControl;
+
+        /// <summary>
+        /// Send commands and image headers as ASCII hex, one exchange at a time,
+        /// for a UBL that predates the binary command frame
+        /// </summary>
+        public Boolean TextCommands;
+
+        /// <summary>
+        /// Directory of the block CRC cache, or null to do without it
+        /// </summary>
+        public String CacheDir;
+
+        /// <summary>
+        /// Run as a flashing station, serving every board that appears on any
+        /// port (starting with SerialPortName, if given), and where to log results
+        /// </summary>
+        public Boolean StationMode;
+        public String StationLogFile;
+
+        /// <summary>
+        /// File each session's telemetry is appended to, or null for none
+        /// </summary>
+        public String TelemetryFile;
     }
     
     /// <summary>
@@ -165,19 +232,62 @@ namespace DVFlasher
         #region Class variables and members
 
         /// <summary>
-        /// Global main Serial Port Object
+        /// Serial port of the session running on this thread
         /// </summary>
+        [ThreadStatic]
         public static SerialPort MySP;
+
+        /// <summary>
+        /// Buffered reader for everything received on MySP
+        /// </summary>
+        [ThreadStatic]
+        public static SerialReader MySPReader;
+
+        /// <summary>
+        /// Timing and traffic figures of the session running on this thread
+        /// </summary>
+        [ThreadStatic]
+        public static Telemetry MyTelemetry;
+
+        /// <summary>
+        /// Sequence already received on this thread's port by the station; the
+        /// next wait for it returns straight away
+        /// </summary>
+        [ThreadStatic]
+        private static String pendingSequence;
+
+        /// <summary>
+        /// Whether this thread's session sends text commands: from -textcmd, or
+        /// since its UBL failed to take up a command frame
+        /// </summary>
+        [ThreadStatic]
+        private static Boolean textCommands;
+
+        /// <summary>
+        /// A command frame has gone out and the UBL has not yet asked for an
+        /// image in answer to it
+        /// </summary>
+        [ThreadStatic]
+        private static Boolean frameUnconfirmed;
+
+        /// <summary>
+        /// Cache of image block CRCs (null when -nocache is given, or once it has
+        /// failed; sessions take a copy before using it)
+        /// </summary>
+        public static ImageCache MyCache;
                 
         /// <summary>
-        /// The main thread used to actually execute everything
+        /// Signalled when a key asks for the program to end
         /// </summary>
-        public static Thread workerThread;
+        public static ManualResetEvent cancelRequested = new ManualResetEvent(false);
 
         /// <summary>
-        /// Global boolean to indicate successful completion of workerThread
+        /// Hand-off of a key to a session that asked a question on the console
         /// </summary>
-        public static Boolean workerThreadSucceeded = false;
+        private static volatile Boolean promptPending = false;
+        private static Boolean noConsoleKeys = false;
+        private static ConsoleKeyInfo promptAnswer;
+        private static AutoResetEvent promptAnswered = new AutoResetEvent(false);
 
         /// <summary>
         /// Public variable to hold needed command line and program parameters
@@ -206,6 +316,7 @@ namespace DVFlasher
             Console.Write("\n\t\t" + "<Option> can be the following:");
             Console.Write("\n\t\t\t" + "-enor\tDo a global erase of the NOR flash.");
             Console.Write("\n\t\t\t" + "-enand\tDo a global erase of the NAND flash.");
+            Console.Write("\n\t\t\t" + "-crcbench\tTime the host CRC-32 code on 1-64 MB of data (no board needed).");
             Console.WriteLine();
 
             Console.Write("\n\tDVFlasher <Option> <Application File>");
@@ -214,20 +325,36 @@ namespace DVFlasher
             Console.Write("\n\t\t\t" + "-r\tRestore NOR Flash with bootable application (typically u-boot).");
             Console.WriteLine();
 
+            Console.Write("\n\tDVFlasher <Option> <Dump File>");
+            Console.Write("\n\t\t" + "<Option> can be any of the following:");
+            Console.Write("\n\t\t\t" + "-dnor\tRead the NOR flash back into <Dump File>.");
+            Console.Write("\n\t\t\t" + "-dnand\tRead the NAND flash back (ECC corrected) into <Dump File>.");
+            Console.WriteLine();
+
+            Console.Write("\n\tDVFlasher <Option> <Golden Image File>");
+            Console.Write("\n\t\t" + "<Option> can be any of the following:");
+            Console.Write("\n\t\t\t" + "-vnor\tCheck the NOR flash against <Golden Image File> by block CRCs.");
+            Console.Write("\n\t\t\t" + "-vnand\tCheck the NAND flash against <Golden Image File> by block CRCs.");
+            Console.Write("\n\t\t" + "NOTE: Reading back and checking flash need a UBL built with READBACK=yes.");
+            Console.WriteLine();
+
             Console.Write("\n\tDVFlasher <Option> <Application File>");
             Console.Write("\n\tDVFlasher <Option> -useMyUBL <Flash UBL File> <Application File>");
             Console.Write("\n\t\t" + "<Option> can be any of the following:" +
                           "\n\t\t\t" + "-fnorbin\tFlash the NOR Flash with bootable UBL and binary application image." +
                           "\n\t\t\t" + "-fnorsrec\tFlash the NOR Flash with bootable UBL and S-record application image." +
+                          "\n\t\t\t" + "-fnorxip\tFlash the NOR Flash with bootable UBL and binary application image" +
+                          "\n\t\t\t" + "        \tthat runs in place from flash (needs -s with its flash entry point)." +
                           "\n\t\t\t" + "-fnandbin\tFlash the NAND Flash with bootable UBL and binary application image." +
                           "\n\t\t\t" + "-fnandsrec\tFlash the NAND Flash with bootable UBL and S-record application image.\n");
             Console.Write("\n\t\t"+"<Flash UBL File> is a maximum 14kB second stage bootloader that" +
                           "\n\t\t" + "is specifically tailored to sit in the NAND or NOR flash and load" + 
                           "\n\t\t" + "the application image stored there.\n");
-            Console.Write("\n\t\t"+"<Application File> is an S-record or binary executable file that"+
+            Console.Write("\n\t\t"+"<Application File> is an S-record, ELF, boot container or binary file that"+
                           "\n\t\t"+"is run after boot or programmed into flash for execution there. Often"+
                           "\n\t\t"+"this will be a third-stage bootloader like u-boot, which can be used to"+
-                          "\n\t\t"+"boot linux.\n");
+                          "\n\t\t"+"boot linux. ELF images and boot containers need a UBL built with"+
+                          "\n\t\t"+"ELF=yes and CONTAINER=yes respectively.\n");
             Console.Write("\t" + "NOTE: Make sure switches and jumpers are set appropriately for Flash type.\n");
 
             Console.Write("\n\t" + "Other Options" +
@@ -236,6 +363,24 @@ namespace DVFlasher
                           "\n\t\t"+"-noRBL            \tUse when system is already running UBL, showing \"BOOTPSP\"." +
                           "\n\t\t"+"-useMyUBL         \tUse your own provided Flash UBL file instead of the internal UBL." +
                           "\n\t\t"+"                  \tExamples of this usage are shown above." +
+                          "\n\t\t"+"-range <Blk> <Cnt>\tOnly read back <Cnt>(hex) blocks from block <Blk>(hex)."+
+                          "\n\t\t"+"-nocompress       \tHave erased pages sent in full when reading back."+
+                          "\n\t\t"+"-chunk <Size>     \tWrite images to the port <Size>(hex) bytes at a time (default 1000)."+
+                          "\n\t\t"+"-rtscts           \tUse RTS/CTS handshaking (UBL must be built with FLOW=rtscts)."+
+                          "\n\t\t"+"-textcmd          \tSend commands as ASCII hex, for a UBL already on the board"+
+                          "\n\t\t"+"                  \tthat predates binary command frames (with -noRBL).  Without"+
+                          "\n\t\t"+"                  \tit, a UBL that does not take a frame gets text commands."+
+                          "\n\t\t"+"-cache <Dir>      \tKeep the block CRCs of verified images in <Dir> instead of the"+
+                          "\n\t\t"+"                  \tdefault location."+
+                          "\n\t\t"+"-nocache          \tWork out block CRCs from scratch and keep nothing."+
+                          "\n\t\t"+"-station          \tRun the command on every board that appears on a serial port"+
+                          "\n\t\t"+"                  \t(with -p, only ports whose names start with <PortName>)."+
+                          "\n\t\t"+"                  \tA finished board is not flashed again: its port is used for"+
+                          "\n\t\t"+"                  \tthe next board once it has disappeared or stayed silent for"+
+                          "\n\t\t"+"                  \t10 s (unplug or power off the board to swap it)."+
+                          "\n\t\t"+"-log <File>       \tAppend each station result to <File> (default station.log)."+
+                          "\n\t\t"+"-telemetry <File> \tAppend the phase timings and throughput of each session to"+
+                          "\n\t\t"+"                  \t<File>, one JSON object per line."+
                           "\n\t\t"+"-p \"<PortName>\" \tUse <PortName> as the serial port (e.g. COM2, /dev/ttyS1)."+
                           "\n\t\t"+"-s \"<StartAddr>\"\tUse <StartAddr>(hex) as the point of execution for the system");
         }   
@@ -286,6 +431,19 @@ namespace DVFlasher
             myCmdParams.FLASHUBLFileName = null;
             myCmdParams.FLASHUBLLoadAddr = 0xFFFFFFFF;
             myCmdParams.FLASHUBLExecAddr = 0x0100;
+
+            myCmdParams.DumpStartBlock = 0;
+            myCmdParams.DumpNumBlocks = 0;
+            myCmdParams.DumpCompress = true;
+
+            myCmdParams.WriteChunkSize = 0x1000;
+            myCmdParams.HWFlowControl = false;
+            myCmdParams.TextCommands = false;
+            myCmdParams.CacheDir = ImageCache.DefaultDirectory;
+
+            myCmdParams.StationMode = false;
+            myCmdParams.StationLogFile = "station.log";
+            myCmdParams.TelemetryFile = null;
             
 
             // For loop for all dash options
@@ -305,6 +463,16 @@ namespace DVFlasher
                             myCmdParams.UBLFlashType = FlashType.NOR;
                             cmdString = "Flashing NOR with ";
                             break;
+                        case "fnorxip":
+                            if (myCmdParams.CMDMagicFlag == MagicFlags.MAGIC_NUMBER_INVALID)
+                                myCmdParams.CMDMagicFlag = MagicFlags.UBL_MAGIC_NOR_BIN_BURN;
+                            else
+                                myCmdParams.Valid = false;
+                            myCmdParams.APPMagicFlag = MagicFlags.UBL_MAGIC_XIP_IMG;
+                            numFiles = 2;
+                            myCmdParams.UBLFlashType = FlashType.NOR;
+                            cmdString = "Flashing NOR (execute in place) with ";
+                            break;
                         case "fnorsrec":
                             if (myCmdParams.CMDMagicFlag == MagicFlags.MAGIC_NUMBER_INVALID)
                                 myCmdParams.CMDMagicFlag = MagicFlags.UBL_MAGIC_NOR_SREC_BURN;
@@ -350,6 +518,86 @@ namespace DVFlasher
                             myCmdParams.UBLFlashType = FlashType.NAND;
                             cmdString = "Globally erasing NAND flash.";
                             break;
+                        case "dnor":
+                            if (myCmdParams.CMDMagicFlag == MagicFlags.MAGIC_NUMBER_INVALID)
+                                myCmdParams.CMDMagicFlag = MagicFlags.UBL_MAGIC_DUMP;
+                            else
+                                myCmdParams.Valid = false;
+                            numFiles = 1;
+                            myCmdParams.UBLFlashType = FlashType.NOR;
+                            cmdString = "Reading NOR flash back into ";
+                            break;
+                        case "dnand":
+                            if (myCmdParams.CMDMagicFlag == MagicFlags.MAGIC_NUMBER_INVALID)
+                                myCmdParams.CMDMagicFlag = MagicFlags.UBL_MAGIC_DUMP;
+                            else
+                                myCmdParams.Valid = false;
+                            numFiles = 1;
+                            myCmdParams.UBLFlashType = FlashType.NAND;
+                            cmdString = "Reading NAND flash back into ";
+                            break;
+                        case "vnor":
+                            if (myCmdParams.CMDMagicFlag == MagicFlags.MAGIC_NUMBER_INVALID)
+                                myCmdParams.CMDMagicFlag = MagicFlags.UBL_MAGIC_VERIFY;
+                            else
+                                myCmdParams.Valid = false;
+                            numFiles = 1;
+                            myCmdParams.UBLFlashType = FlashType.NOR;
+                            cmdString = "Verifying NOR flash against ";
+                            break;
+                        case "vnand":
+                            if (myCmdParams.CMDMagicFlag == MagicFlags.MAGIC_NUMBER_INVALID)
+                                myCmdParams.CMDMagicFlag = MagicFlags.UBL_MAGIC_VERIFY;
+                            else
+                                myCmdParams.Valid = false;
+                            numFiles = 1;
+                            myCmdParams.UBLFlashType = FlashType.NAND;
+                            cmdString = "Verifying NAND flash against ";
+                            break;
+                        case "range":
+                            myCmdParams.DumpStartBlock = UInt32.Parse(args[i + 1].Replace("0x", ""), NumberStyles.AllowHexSpecifier);
+                            myCmdParams.DumpNumBlocks = UInt32.Parse(args[i + 2].Replace("0x", ""), NumberStyles.AllowHexSpecifier);
+                            argsHandled[i + 1] = true;
+                            argsHandled[i + 2] = true;
+                            numHandledArgs += 2;
+                            break;
+                        case "nocompress":
+                            myCmdParams.DumpCompress = false;
+                            break;
+                        case "chunk":
+                            myCmdParams.WriteChunkSize = Int32.Parse(args[i + 1].Replace("0x", ""), NumberStyles.AllowHexSpecifier);
+                            if (myCmdParams.WriteChunkSize <= 0)
+                                myCmdParams.Valid = false;
+                            argsHandled[i + 1] = true;
+                            numHandledArgs++;
+                            break;
+                        case "rtscts":
+                            myCmdParams.HWFlowControl = true;
+                            break;
+                        case "textcmd":
+                            myCmdParams.TextCommands = true;
+                            break;
+                        case "cache":
+                            myCmdParams.CacheDir = args[i + 1];
+                            argsHandled[i + 1] = true;
+                            numHandledArgs++;
+                            break;
+                        case "nocache":
+                            myCmdParams.CacheDir = null;
+                            break;
+                        case "station":
+                            myCmdParams.StationMode = true;
+                            break;
+                        case "log":
+                            myCmdParams.StationLogFile = args[i + 1];
+                            argsHandled[i + 1] = true;
+                            numHandledArgs++;
+                            break;
+                        case "telemetry":
+                            myCmdParams.TelemetryFile = args[i + 1];
+                            argsHandled[i + 1] = true;
+                            numHandledArgs++;
+                            break;
                         case "r":
                             if (myCmdParams.CMDMagicFlag == MagicFlags.MAGIC_NUMBER_INVALID)
                                 myCmdParams.CMDMagicFlag = MagicFlags.UBL_MAGIC_NOR_RESTORE;
@@ -497,14 +745,22 @@ namespace DVFlasher
             if (myCmdParams.APPLoadAddr == 0xFFFFFFFF)
                 myCmdParams.APPLoadAddr = 0x81080000;
 
+            // An execute-in-place image has no sensible default entry point
+            if ( (myCmdParams.APPMagicFlag == MagicFlags.UBL_MAGIC_XIP_IMG) &&
+                 (myCmdParams.APPEntryPoint == 0xFFFFFFFF) )
+            {
+                myCmdParams.Valid = false;
+                return myCmdParams;
+            }
+
             if (myCmdParams.APPEntryPoint == 0xFFFFFFFF)
                 myCmdParams.APPEntryPoint = 0x81080000;
 
             if (myCmdParams.FLASHUBLLoadAddr == 0xFFFFFFFF)
                 myCmdParams.FLASHUBLLoadAddr = 0x81070000;
             
-            //Setup default serial port name
-            if (myCmdParams.SerialPortName == null)
+            //Setup default serial port name (a station uses every port by default)
+            if ((myCmdParams.SerialPortName == null) && !myCmdParams.StationMode)
             {
                 int p = (int)Environment.OSVersion.Platform;
                 if ((p == 4) || (p == 128)) //Check for unix
@@ -529,6 +785,9 @@ namespace DVFlasher
         /// <returns>Return code: 0 for correct exit, -1 for unexpected exit</returns>
         static Int32 Main(String[] args)
         {
+            SerialPort sp;
+            Session session;
+
             // Begin main code
             Console.Clear();
             Console.WriteLine("-----------------------------------------------------");
@@ -537,6 +796,13 @@ namespace DVFlasher
             Console.WriteLine("-----------------------------------------------------");
             Console.Write("\n\n");
 
+            // Host-only timing of the CRC-32 code, no board needed
+            if ((args.Length == 1) && (args[0].ToLower() == "-crcbench"))
+            {
+                CRC32.Benchmark();
+                return 0;
+            }
+
             // Parse command line
             cmdParams = ParseCmdLine(args);
             if (!cmdParams.Valid)
@@ -549,65 +815,52 @@ namespace DVFlasher
                 Console.Write(cmdString + "\n\n\n");
             }
                                    
-            try
-            {
-                Console.WriteLine("Attempting to connect to device " + cmdParams.SerialPortName + "...");
-                MySP = new SerialPort(cmdParams.SerialPortName, 115200, Parity.None, 8, StopBits.One);
-                MySP.Encoding = Encoding.ASCII;
-                MySP.Open();
-            }
-            catch(Exception e)
+
+            // Open the block CRC cache; flashing works without it
+            if (cmdParams.CacheDir != null)
             {
-                if (e is UnauthorizedAccessException)
+                try
                 {
-                    Console.WriteLine(e.Message);
-                    Console.WriteLine("This application failed to open the COM port.");
-                    Console.WriteLine("Most likely it is in use by some other application.");
-                    return -1;
+                    MyCache = new ImageCache(cmdParams.CacheDir);
+                }
+                catch (IOException e)
+                {
+                    cacheFailed(e);
+                }
+                catch (UnauthorizedAccessException e)
+                {
+                    cacheFailed(e);
                 }
-                Console.WriteLine(e.Message);
-                return -1;
             }
 
-
             Console.WriteLine("Press any key to end this program at any time.\n");
-            
-            // Setup the thread that will actually do all the work of interfacing to
-            // the DM644x boot ROM.  Start that thread.
-            workerThread = new Thread(new ThreadStart(Program.WorkerThreadStart));
-            workerThread.Start();
+            StartKeyThread();
 
-            // Wait for a key to terminate the program
-            while ((workerThread.IsAlive) && (!Console.KeyAvailable))
-            {
-                Thread.Sleep(1000);
-            }
-                       
-            // If a key is pressed then abort the worker thread and close the serial port
-            try
+            if (cmdParams.StationMode)
             {
-                if (Console.KeyAvailable)
-                {
-                    Console.ReadKey();
-                    Console.WriteLine("Aborting program...");
-                    workerThread.Abort();
-                }
-                else if (workerThread.IsAlive)
-                {
-                    Console.WriteLine("Aborting program...");
-                    workerThread.Abort();
-                }
-                
-                while ((workerThread.ThreadState & ThreadState.Stopped) != ThreadState.Stopped){}
+                (new Station(cmdParams.SerialPortName, cmdParams.StationLogFile, cmdString)).Run(cancelRequested);
+                return 0;
             }
-            catch (Exception e)
+
+            Console.WriteLine("Attempting to connect to device " + cmdParams.SerialPortName + "...");
+            sp = OpenPort(cmdParams.SerialPortName);
+            if (sp == null)
+                return -1;
+
+            // Start the session that does all the work of interfacing to the
+            // DM644x, then sleep until it finishes or a key asks us to stop
+            session = new Session(sp);
+            session.Start();
+
+            if (WaitHandle.WaitAny(new WaitHandle[] { session.Done, cancelRequested }) != 0)
             {
-                Console.WriteLine("Abort thread error...");
-                Console.WriteLine(e.GetType());
-                Console.WriteLine(e.Message);
+                // Closing the port fails whatever the session is blocked on
+                Console.WriteLine("Aborting program...");
+                session.Cancel();
+                session.Done.WaitOne();
             }
             
-            if (workerThreadSucceeded)
+            if (session.Succeeded)
             {
                 Console.WriteLine("\nOperation completed successfully.");
                 return 0;
@@ -626,197 +879,332 @@ namespace DVFlasher
         
 
         //**********************************************************************************
-        #region Code for UART interfacing thread
+        #region Code for UART interfacing sessions
 
         /// <summary>
-        /// The main fucntion of the thread where all the cool stuff happens
-        /// to interface with the DVEVM
+        /// Open a serial port for talking to the ROM and UBL, reporting why
+        /// if it cannot be opened
         /// </summary>
-        public static void WorkerThreadStart()
+        /// <param name="portName">Name of the port.</param>
+        /// <returns>The open port, or null.</returns>
+        public static SerialPort OpenPort(String portName)
         {
-            // Try transmitting the first stage boot-loader (UBL) via the RBL
+            SerialPort sp;
+
             try
             {
-                if (cmdParams.UARTUBLUsed)
-                    TransmitUARTUBL();
+                sp = new SerialPort(portName, 115200, Parity.None, 8, StopBits.One);
+                sp.Encoding = Encoding.ASCII;
+                sp.Open();
             }
-            catch (Exception e)
+            catch(Exception e)
             {
-                if (e is ThreadAbortException)
-                {
-                    Thread.Sleep(1000);
-                }
-                else
+                if (e is UnauthorizedAccessException)
                 {
                     Console.WriteLine(e.Message);
+                    Console.WriteLine("This application failed to open the COM port.");
+                    Console.WriteLine("Most likely it is in use by some other application.");
+                    return null;
                 }
-                return;
+                Console.WriteLine(e.Message);
+                return null;
             }
+            return sp;
+        }
+
+        /// <summary>
+        /// Start the thread that reads keys from the console.  A key is the
+        /// answer to a question if a session has asked one, and otherwise
+        /// a request to end the program.
+        /// </summary>
+        private static void StartKeyThread()
+        {
+            Thread keyThread = new Thread(new ThreadStart(Program.KeyThreadStart));
+
+            keyThread.IsBackground = true;
+            keyThread.Start();
+        }
+
+        private static void KeyThreadStart()
+        {
+            ConsoleKeyInfo key;
 
-            // Sleep in case we need to abort
-            Thread.Sleep(200);
-            
-            // Code to perform specified command
             try
             {
-                // Wait for the bootmode to be sent
-                if (!waitForSequence("PSPBootMode = UART", "PSPBootMode = N", MySP, true))
+                while (true)
                 {
-                    Console.WriteLine("\nWARNING! The DM644x is NOT in UART boot mode!");
-                    Console.WriteLine("Only continue if you are sure of what you are doing.");
-                    Console.Write("\n\tContinue (Y/N) ? ");
-                    if (!String.Equals(
-                            Console.ReadKey().Key.ToString(),
-                            "y",
-                            StringComparison.CurrentCultureIgnoreCase)
-                        )
+                    key = Console.ReadKey(true);
+                    if (promptPending)
                     {
-                        Console.WriteLine("\n\nCheck your switch and jumper settings, if appropriate.");
-                        Thread.CurrentThread.Abort();
+                        promptAnswer = key;
+                        promptAnswered.Set();
                     }
                     else
-                        Console.WriteLine();
-                }
-                
-                // Clear input buffer so we can start looking for BOOTPSP
-                MySP.DiscardInBuffer();
-
-                // Take appropriate action depending on command
-                switch (cmdParams.CMDMagicFlag)
-                {
-                    case MagicFlags.UBL_MAGIC_NAND_BIN_BURN:
-                        {
-                            TransmitFLASHUBLandAPP();
-                            break;
-                        }
-                    case MagicFlags.UBL_MAGIC_NAND_SREC_BURN:
-                        {
-                            TransmitFLASHUBLandAPP();
-                            break;
-                        }
-                    case MagicFlags.UBL_MAGIC_NOR_BIN_BURN:
-                        {
-                            TransmitFLASHUBLandAPP();
-                            break;
-                        }
-                    case MagicFlags.UBL_MAGIC_NOR_SREC_BURN:
-                        {
-                            TransmitFLASHUBLandAPP();
-                            break;
-                        }
-                    case MagicFlags.UBL_MAGIC_NOR_GLOBAL_ERASE:
-                        {
-                            TransmitErase();
-                            break;
-                        }
-                    case MagicFlags.UBL_MAGIC_NAND_GLOBAL_ERASE:
-                        {
-                            TransmitErase();
-                            break;
-                        }
-                    case MagicFlags.UBL_MAGIC_NOR_RESTORE:
-                        {
-                            TransmitAPP();
-                            break;
-                        }
-                    case MagicFlags.UBL_MAGIC_SAFE:
-                        {
-                            TransmitAPP();
-                            break;
-                        }
-                    default:
-                        {
-                            Console.WriteLine("Command not recognized!");
-                            break;
-                        }
+                    {
+                        cancelRequested.Set();
+                        return;
+                    }
                 }
             }
-            catch (Exception e)
+            catch (InvalidOperationException)
             {
-                if (e is ThreadAbortException)
-                {
-                    Thread.Sleep(1000);
-                }
-                else
-                {
-                    Console.WriteLine(e.Message);
-                }
-                return;
+                // Input is not a console, so no keys will come
+                noConsoleKeys = true;
+                promptAnswered.Set();
             }
-            
-            // Everything worked, so change boolean status
-            workerThreadSucceeded = true;
         }
 
         /// <summary>
-        /// Read the appropriate embedded UBL data (NAND or NOR) that
-        /// will be transmitted to the DM644x.
+        /// Wait for the answer to a question printed on the console.  Without a
+        /// console, or if the program is being ended, the answer is 'N'.
         /// </summary>
-        /// <returns>A Stream object of the UBL data</returns>
-        private static Stream GetEmbeddedUBLStream()
+        /// <returns>The key pressed.</returns>
+        public static ConsoleKey ReadPromptKey()
         {
-            String srchStr;
-            Stream UBLstream;
-            String UBLResourceName = "";
+            ConsoleKey key = ConsoleKey.N;
 
-            Assembly executingAssembly = Assembly.GetExecutingAssembly();
+            promptPending = true;
+            if ((WaitHandle.WaitAny(new WaitHandle[] { promptAnswered, cancelRequested }) == 0) && !noConsoleKeys)
+                key = promptAnswer.Key;
+            promptPending = false;
 
-            if (cmdParams.UBLFlashType == FlashType.NAND)
-                srchStr = "ubl_davinci_nand.bin";
-            else
-                srchStr = "ubl_davinci_nor.bin";
+            Console.WriteLine(key.ToString());
+            return key;
+        }
 
-            executingAssembly = Assembly.GetExecutingAssembly();
-            foreach (String s in executingAssembly.GetManifestResourceNames())
-            {
-                if (s.Contains(srchStr))
-                {
-                    UBLResourceName = s;
-                    break;
-                }
-            }
-            try
-            {
-                UBLstream = executingAssembly.GetManifestResourceStream(UBLResourceName);
-            }
-            catch (FileNotFoundException e)
-            {
-                Console.WriteLine("The embedded UBL file was not found.");
-                throw e;
-            }
-            return UBLstream;
+        /// <summary>
+        /// Wait for a board to announce itself: the ROM with " BOOTME" or an
+        /// already running UBL with "BOOTPSP".
+        /// </summary>
+        /// <returns>The sequence received.</returns>
+        public static String WaitForBanner()
+        {
+            String[] banners = { " BOOTME\0", "BOOTPSP\0" };
+
+            return banners[MySPReader.WaitFor(cmdParams.Verbose, banners)];
         }
 
         /// <summary>
-        /// Function to find, read, and convert to S-record (if needed) a data file
+        /// Everything a session does to interface with the DVEVM: send the UART
+        /// UBL to the ROM if needed, then carry out the command given.  Runs on
+        /// the session's thread; errors are thrown to the session.
         /// </summary>
-        /// <param name="filename">The name of the file to load</param>
-        /// <param name="decAddr">The address to which the data should be loaded in memory
-        /// on the DM644x device.
-        /// </param>
-        /// <returns></returns>
-        private static Byte[] GetFileData(String filename, UInt32 decAddr)
+        /// <param name="banner">Sequence the board has already announced itself
+        /// with (from WaitForBanner), or null to follow the command line.</param>
+        /// <returns>True if the command was carried out.</returns>
+        public static Boolean RunCommand(String banner)
         {
-            FileStream fs;
-            Byte[] data;
+            pendingSequence = banner;
+            textCommands = cmdParams.TextCommands;
+            frameUnconfirmed = false;
 
-            if (!File.Exists(filename))
+            // Try transmitting the first stage boot-loader (UBL) via the RBL,
+            // which does not drive CTS
+            if ((banner == null) ? cmdParams.UARTUBLUsed : (banner == " BOOTME\0"))
+            {
+                MySP.Handshake = Handshake.None;
+                TransmitUARTUBL();
+            }
+
+            // The UART UBL has reported in, so handshaking can start
+            if (cmdParams.HWFlowControl)
+                MySP.Handshake = Handshake.RequestToSend;
+
+            // Wait for the bootmode to be sent (a UBL already at BOOTPSP has
+            // printed it long ago)
+            if ((banner != "BOOTPSP\0") &&
+                !waitForSequence("PSPBootMode = UART", "PSPBootMode = N", MySPReader, true))
+            {
+                Console.WriteLine("\nWARNING! The DM644x is NOT in UART boot mode!");
+                Console.WriteLine("Only continue if you are sure of what you are doing.");
+                Console.Write("\n\tContinue (Y/N) ? ");
+                if (ReadPromptKey() != ConsoleKey.Y)
+                {
+                    Console.WriteLine("\n\nCheck your switch and jumper settings, if appropriate.");
+                    return false;
+                }
+            }
+            
+            // Clear input buffer so we can start looking for BOOTPSP
+            MySPReader.DiscardInBuffer();
+
+            // Take appropriate action depending on command
+            switch (cmdParams.CMDMagicFlag)
+            {
+                case MagicFlags.UBL_MAGIC_NAND_BIN_BURN:
+                    {
+                        TransmitFLASHUBLandAPP();
+                        break;
+                    }
+                case MagicFlags.UBL_MAGIC_NAND_SREC_BURN:
+                    {
+                        TransmitFLASHUBLandAPP();
+                        break;
+                    }
+                case MagicFlags.UBL_MAGIC_NOR_BIN_BURN:
+                    {
+                        TransmitFLASHUBLandAPP();
+                        break;
+                    }
+                case MagicFlags.UBL_MAGIC_NOR_SREC_BURN:
+                    {
+                        TransmitFLASHUBLandAPP();
+                        break;
+                    }
+                case MagicFlags.UBL_MAGIC_NOR_GLOBAL_ERASE:
+                    {
+                        TransmitErase();
+                        break;
+                    }
+                case MagicFlags.UBL_MAGIC_NAND_GLOBAL_ERASE:
+                    {
+                        TransmitErase();
+                        break;
+                    }
+                case MagicFlags.UBL_MAGIC_NOR_RESTORE:
+                    {
+                        TransmitAPP();
+                        break;
+                    }
+                case MagicFlags.UBL_MAGIC_SAFE:
+                    {
+                        TransmitAPP();
+                        break;
+                    }
+                case MagicFlags.UBL_MAGIC_DUMP:
+                    {
+                        ReceiveDump();
+                        break;
+                    }
+                case MagicFlags.UBL_MAGIC_VERIFY:
+                    {
+                        VerifyFlash();
+                        break;
+                    }
+                default:
+                    {
+                        Console.WriteLine("Command not recognized!");
+                        break;
+                    }
+            }
+
+            // Everything worked
+            return true;
+        }
+
+        /// <summary>
+        /// Read the appropriate embedded UBL data (NAND or NOR) that
+        /// will be transmitted to the DM644x.
+        /// </summary>
+        /// <returns>A Stream object of the UBL data</returns>
+        private static Stream GetEmbeddedUBLStream()
+        {
+            String srchStr;
+            Stream UBLstream;
+            String UBLResourceName = "";
+
+            Assembly executingAssembly = Assembly.GetExecutingAssembly();
+
+            if (cmdParams.UBLFlashType == FlashType.NAND)
+                srchStr = "ubl_davinci_nand.bin";
+            else
+                srchStr = "ubl_davinci_nor.bin";
+
+            executingAssembly = Assembly.GetExecutingAssembly();
+            foreach (String s in executingAssembly.GetManifestResourceNames())
+            {
+                if (s.Contains(srchStr))
+                {
+                    UBLResourceName = s;
+                    break;
+                }
+            }
+            try
+            {
+                UBLstream = executingAssembly.GetManifestResourceStream(UBLResourceName);
+            }
+            catch (FileNotFoundException e)
+            {
+                Console.WriteLine("The embedded UBL file was not found.");
+                throw e;
+            }
+            return UBLstream;
+        }
+
+        /// <summary>
+        /// Function to find, read, and convert to S-record (if needed) a data file
+        /// </summary>
+        /// <param name="filename">The name of the file to load</param>
+        /// <param name="decAddr">The address to which the data should be loaded in memory
+        /// on the DM644x device.
+        /// </param>
+        /// <returns>A stream of the data to send, positioned at its start.</returns>
+        private static Stream GetFileData(String filename, UInt32 decAddr)
+        {
+            FileStream fs;
+            Stream data;
+
+            if (!File.Exists(filename))
             {
                 throw new FileNotFoundException("File " + filename + " is not present.");
             }
 
             // Open file and setup the binary stream reader
-            fs = File.Open(cmdParams.APPFileName, FileMode.Open, FileAccess.Read);
+            fs = File.Open(filename, FileMode.Open, FileAccess.Read);
 
+            // ELF executables are sent as they are and loaded by the UBL itself
+            if (isFileElf(fs))
+            {
+                if (cmdParams.APPMagicFlag == MagicFlags.UBL_MAGIC_XIP_IMG)
+                {
+                    fs.Close();
+                    throw new ArgumentException("Execute-in-place application must be a binary file.");
+                }
+                if ( (cmdParams.CMDMagicFlag == MagicFlags.UBL_MAGIC_NOR_BIN_BURN) ||
+                     (cmdParams.CMDMagicFlag == MagicFlags.UBL_MAGIC_NAND_BIN_BURN) )
+                {
+                    fs.Close();
+                    throw new ArgumentException("ELF and container images must be flashed with -fnorsrec or -fnandsrec.");
+                }
+                data = fs;
+                cmdParams.APPEntryPoint = readWordAt(fs, 24);
+                Console.WriteLine("ELF image, using {0:x8} (e_entry) as the execution address.", cmdParams.APPEntryPoint);
+            }
+            // Boot containers are likewise sent as they are
+            else if (isFileContainer(fs))
+            {
+                if (cmdParams.APPMagicFlag == MagicFlags.UBL_MAGIC_XIP_IMG)
+                {
+                    fs.Close();
+                    throw new ArgumentException("Execute-in-place application must be a binary file.");
+                }
+                if ( (cmdParams.CMDMagicFlag == MagicFlags.UBL_MAGIC_NOR_BIN_BURN) ||
+                     (cmdParams.CMDMagicFlag == MagicFlags.UBL_MAGIC_NAND_BIN_BURN) )
+                {
+                    fs.Close();
+                    throw new ArgumentException("ELF and container images must be flashed with -fnorsrec or -fnandsrec.");
+                }
+                data = fs;
+                cmdParams.APPEntryPoint = readWordAt(fs, 8);
+                Console.WriteLine("Boot container, using {0:x8} as the execution address.", cmdParams.APPEntryPoint);
+            }
             // Check to see if the file is an s-record file
-            if (isFileSrec(fs))
+            else if (isFileSrec(fs))
             {
-                data = readSrec(fs);
+                // An execute-in-place image is stored as-is, so its s-records
+                // could not be decoded to the flash addresses they name
+                if (cmdParams.APPMagicFlag == MagicFlags.UBL_MAGIC_XIP_IMG)
+                {
+                    fs.Close();
+                    throw new ArgumentException("Execute-in-place application must be a binary file.");
+                }
+                data = fs;
             }
             else //Assume the file is a binary file
             {
                 data = bin2srec(fs, decAddr);
             }
+            data.Position = 0;
             return data;
         }
 
@@ -866,10 +1254,11 @@ namespace DVFlasher
                 Console.WriteLine("\nWaiting for DVEVM...");
 
                 // Wait for the DVEVM to send the ^BOOTME/0 sequence
-                if (waitForSequence(" BOOTME\0", " BOOTME\0", MySP))
+                if (waitForSequence(" BOOTME\0", " BOOTME\0", MySPReader))
                     Console.WriteLine("BOOTME commmand received. Returning ACK and header...");
                 else
                     goto BOOTMESEQ;
+                MyTelemetry.MarkAttempt("bootme");
 
                 // Output 28 Bytes for the ACK sequence and header
                 // 8 bytes acknowledge sequence = "    ACK\0"
@@ -889,10 +1278,11 @@ namespace DVFlasher
                 Console.WriteLine("ACK command sent. Waiting for BEGIN command... ");
 
                 // Wait for the BEGIN sequence
-                if (waitForSequence("  BEGIN\0", " BOOTME\0", MySP,true))
+                if (waitForSequence("  BEGIN\0", " BOOTME\0", MySPReader,true))
                     Console.WriteLine("BEGIN commmand received. Sending CRC table...");
                 else
                     goto BOOTMESEQ;
+                MyTelemetry.Mark("crc_table");
 
                 // Send the 1024 byte (256 word) CRC table
                 for (int i = 0; i < MyCRC.Length; i++)
@@ -904,19 +1294,21 @@ namespace DVFlasher
                 
 
                 // Wait for the first DONE sequence
-                if (waitForSequence("   DONE\0", " BOOTME\0", MySP))
+                if (waitForSequence("   DONE\0", " BOOTME\0", MySPReader))
                     Console.WriteLine("DONE received.  Sending the UART UBL file...");
                 else
                     goto BOOTMESEQ;
+                MyTelemetry.Mark("ubl_upload");
 
                 // Send the contents of the UBL file 
-                MySP.Write(UBLsb.ToString());
+                writeStream(new MemoryStream(Encoding.ASCII.GetBytes(UBLsb.ToString())), 0, true);
 
                 // Wait for the second DONE sequence
-                if (waitForSequence("   DONE\0", " BOOTME\0", MySP))
+                if (waitForSequence("   DONE\0", " BOOTME\0", MySPReader))
                     Console.WriteLine("DONE received.  UART UBL file was accepted.");
                 else
                     goto BOOTMESEQ;
+                MyTelemetry.Mark("ubl_accepted");
 
                 Console.WriteLine("UART UBL Transmitted successfully.\n");
 
@@ -929,29 +1321,58 @@ namespace DVFlasher
         }
 
         /// <summary>
-        /// Function to transmit the CMD and command over the UART (following BOOTPSP)
+        /// Function to transmit the CMD and command over the UART (following BOOTPSP).
+        /// Unless -textcmd is given, the command goes out as one binary frame
+        /// together with the headers of the images it needs, so the UBL asks
+        /// for nothing more than the image data itself.  If the UBL starts over
+        /// instead of taking up the frame (it predates frames, timed out, or
+        /// answered " BADCRC"), text commands are used from then on.
         /// </summary>
-        private static Boolean TransmitCMDSuccessful()
+        /// <param name="headers">Headers of the images the command sends, in order.</param>
+        private static Boolean TransmitCMDSuccessful(params ImageHeader[] headers)
         {
+            Byte[] frame;
+
             try
             {
                 // Clear input buffer so we can start looking for BOOTPSP
-                MySP.DiscardInBuffer();
+                MySPReader.DiscardInBuffer();
 
                 Console.WriteLine("\nWaiting for UBL on DVEVM...");        
                 
                 // Wait for the UBL on the DVEVM to send the ^BOOTPSP\0 sequence
-                if (waitForSequence("BOOTPSP\0", "BOOTPSP\0", MySP))
+                if (waitForSequence("BOOTPSP\0", "BOOTPSP\0", MySPReader))
                     Console.WriteLine("UBL's BOOTPSP commmand received. Returning CMD and command...");
                 else
                     return false;
+                MyTelemetry.MarkAttempt("cmd");
 
-                // 8 bytes acknowledge sequence = "    CMD\0"
-                MySP.Write("    CMD\0");
-                // 8 bytes of magic number
-                MySP.Write(((UInt32)cmdParams.CMDMagicFlag).ToString("X8"));
+                if (frameUnconfirmed)
+                {
+                    Console.WriteLine("UBL did not take the CMD frame.  Falling back to text commands.");
+                    textCommands = true;
+                    frameUnconfirmed = false;
+                }
+
+                if (textCommands)
+                {
+                    // 8 bytes acknowledge sequence = "    CMD\0"
+                    MySP.Write("    CMD\0");
+                    // 8 bytes of magic number
+                    MySP.Write(((UInt32)cmdParams.CMDMagicFlag).ToString("X8"));
                 
-                Console.WriteLine("CMD value sent.");
+                    Console.WriteLine("CMD value sent.");
+                }
+                else
+                {
+                    // 8 bytes frame sequence = "  FRAME\0", then the frame
+                    frame = buildCmdFrame((UInt32)cmdParams.CMDMagicFlag, headers);
+                    MySP.Write("  FRAME\0");
+                    MySP.Write(frame, 0, frame.Length);
+                    frameUnconfirmed = true;
+
+                    Console.WriteLine("CMD frame sent.");
+                }
             }
             catch (ObjectDisposedException e)
             {
@@ -961,6 +1382,84 @@ namespace DVFlasher
             return true;
         }
 
+        /// <summary>
+        /// Build a binary command frame (UART_CMD_FRAME in the UBL's uart.h):
+        /// command, header count, two header slots and a CRC-32 of all that,
+        /// every field a little-endian 32-bit word
+        /// </summary>
+        /// <param name="cmd">Command magic number.</param>
+        /// <param name="headers">Headers to send with it (at most two).</param>
+        /// <returns>The frame.</returns>
+        private static Byte[] buildCmdFrame(UInt32 cmd, ImageHeader[] headers)
+        {
+            const Int32 maxHeaders = 2;
+            Byte[] frame = new Byte[12 + (16 * maxHeaders)];
+            Byte[] body = new Byte[frame.Length - 4];
+            Int32 pos;
+
+            if (headers.Length > maxHeaders)
+                throw new ArgumentException("Too many image headers for one command frame.");
+
+            putWord(body, 0, cmd);
+            putWord(body, 4, (UInt32)headers.Length);
+            for (Int32 i = 0; i < headers.Length; i++)
+            {
+                pos = 8 + (16 * i);
+                putWord(body, pos, headers[i].MagicNum);
+                putWord(body, pos + 4, headers[i].EntryPoint);
+                putWord(body, pos + 8, headers[i].ByteCount);
+                putWord(body, pos + 12, headers[i].Flags);
+            }
+
+            body.CopyTo(frame, 0);
+            putWord(frame, body.Length, (new CRC32()).CalculateCRC(body));
+            return frame;
+        }
+
+        /// <summary>
+        /// Store a 32-bit word little-endian, whatever the host is
+        /// </summary>
+        private static void putWord(Byte[] buf, Int32 offset, UInt32 value)
+        {
+            buf[offset]     = (Byte)value;
+            buf[offset + 1] = (Byte)(value >> 8);
+            buf[offset + 2] = (Byte)(value >> 16);
+            buf[offset + 3] = (Byte)(value >> 24);
+        }
+
+        /// <summary>
+        /// Answer the UBL's request for an image header.  With a binary command
+        /// frame the header has already gone out with the command, and the
+        /// request only marks the phase.
+        /// </summary>
+        /// <param name="sendSeq">Sequence the UBL asks with ("SENDUBL\0" or "SENDAPP\0").</param>
+        /// <param name="header">The header to send.</param>
+        /// <param name="verbose">Echo what the UBL says while waiting.</param>
+        /// <returns>False if the UBL started over instead.</returns>
+        private static Boolean sendHeader(String sendSeq, ImageHeader header, Boolean verbose)
+        {
+            if (!waitForSequence(sendSeq, "BOOTPSP\0", MySPReader, verbose))
+                return false;
+            MyTelemetry.Mark(sendSeq.TrimEnd('\0').ToLower());
+            if (!textCommands)
+                return true;
+            Console.WriteLine(sendSeq.TrimEnd('\0') + " received. Returning ACK and header...");
+
+            // Output 36 Bytes for the ACK sequence and header
+            // 8 bytes acknowledge sequence = "    ACK\0"
+            MySP.Write("    ACK\0");
+            // 8 bytes of magic number
+            MySP.Write(header.MagicNum.ToString("X8"));
+            // 8 bytes of binary execution address = ASCII string of 8 hex characters
+            MySP.Write(header.EntryPoint.ToString("X8"));
+            // 8 bytes of data size = ASCII string of 8 hex characters
+            MySP.Write(header.ByteCount.ToString("X8"));
+            // 4 bytes of flags (0001 = can resume an interrupted transfer)
+            MySP.Write(header.Flags.ToString("X4"));
+
+            return true;
+        }
+
         /// <summary>
         /// Send command and wait for erase response. (NOR and NAND global erase)
         /// </summary>
@@ -973,8 +1472,9 @@ namespace DVFlasher
                 if (!TransmitCMDSuccessful())
                     goto BOOTPSPSEQ1;
 
-                if (!waitForSequence("   DONE\0", "BOOTPSP\0", MySP, true))
+                if (!waitForSequence("   DONE\0", "BOOTPSP\0", MySPReader, true))
                     goto BOOTPSPSEQ1;
+                MyTelemetry.Mark("done");
 
             }
             catch (ObjectDisposedException e)
@@ -993,66 +1493,60 @@ namespace DVFlasher
         private static void TransmitAPP()
         {
             // Local Variables for reading APP file
-            Byte[] APPFileData;
+            Stream APPFileData;
+            ImageHeader APPHeader;
+            Int32 appOffset;
 
             APPFileData = GetFileData(cmdParams.APPFileName, cmdParams.APPLoadAddr);
 
+            // Flags 0001: can resume an interrupted transfer
+            APPHeader = new ImageHeader((UInt32)cmdParams.APPMagicFlag, cmdParams.APPEntryPoint,
+                                        (UInt32)APPFileData.Length, 0x0001);
+
             try
             {
             BOOTPSPSEQ3:
 
                 // Send the UBL command
-                if (!TransmitCMDSuccessful())
+                if (!TransmitCMDSuccessful(APPHeader))
                     goto BOOTPSPSEQ3;
 
-                if (waitForSequence("SENDAPP\0", "BOOTPSP\0", MySP))
-                {
-                    Console.WriteLine("SENDAPP received. Returning ACK and header for application data...");
-                }
-                else
-                {
+                if (!sendHeader("SENDAPP\0", APPHeader, cmdParams.Verbose))
                     goto BOOTPSPSEQ3;
-                }
 
-                // Output 36 Bytes for the ACK sequence and header
-                // 8 bytes acknowledge sequence = "    ACK\0"
-                MySP.Write("    ACK\0");
-                // 8 bytes of magic number (in this case flash the nor
-                MySP.Write(((UInt32)cmdParams.APPMagicFlag).ToString("X8"));
-                // 8 bytes of binary execution address = ASCII string of 8 hex characters
-                MySP.Write(String.Format("{0:X8}", cmdParams.APPEntryPoint));
-                // 8 bytes of data size = ASCII string of 8 hex characters
-                MySP.Write(((UInt32)APPFileData.Length).ToString("X8"));
-                // 4 bytes of constant zeros = "0000"
-                MySP.Write("0000");
+                // Agree where to start sending from
+                appOffset = negotiateResume(APPFileData, MySPReader);
+                if (appOffset < 0)
+                    goto BOOTPSPSEQ3;
 
-                Console.WriteLine("ACK command sent. Waiting for BEGIN command... ");
+                Console.WriteLine("Waiting for BEGIN command... ");
 
                 // Wait for the ^^BEGIN\0 sequence
-                if (waitForSequence("  BEGIN\0", "BOOTPSP\0", MySP))
+                if (waitForSequence("  BEGIN\0", "BOOTPSP\0", MySPReader))
                     Console.WriteLine("UBL's BEGIN commmand received. Sending the application code...");
                 else
                     goto BOOTPSPSEQ3;
 
                 // Send the application code (should be in S-record format)
-                MySP.Write(APPFileData, 0, APPFileData.Length);
+                writeStream(APPFileData, appOffset);
                 Console.WriteLine("Application code sent.  Waiting for DONE...");
 
                 // Wait for ^^^DONE\0
-                if (waitForSequence("   DONE\0", "BOOTPSP\0", MySP))
+                if (waitForSequence("   DONE\0", "BOOTPSP\0", MySPReader))
                     Console.WriteLine("DONE received.  All bytes of application code received...");
                 else
                     goto BOOTPSPSEQ3;
 
                 // Wait for second ^^^DONE\0 to indicate the S-record decode worked
-                if (waitForSequence("   DONE\0", "BOOTPSP\0", MySP))
+                if (waitForSequence("   DONE\0", "BOOTPSP\0", MySPReader))
                     Console.WriteLine("DONE received.  Application S-record decoded correctly.");
                 else
                     goto BOOTPSPSEQ3;
                 
                 // Wait for third ^^^DONE that indicates booting
-                if (!waitForSequence("   DONE\0", "BOOTPSP\0", MySP, true))
+                if (!waitForSequence("   DONE\0", "BOOTPSP\0", MySPReader, true))
                     throw new Exception("Final DONE not returned.  Command failed on DM644x.");
+                MyTelemetry.Mark("done");
 
             }
             catch (ObjectDisposedException e)
@@ -1060,6 +1554,10 @@ namespace DVFlasher
                 Console.WriteLine(e.StackTrace);
                 throw e;
             }
+            finally
+            {
+                APPFileData.Close();
+            }
 
         }
 
@@ -1068,8 +1566,11 @@ namespace DVFlasher
         /// </summary>
         private static void TransmitFLASHUBLandAPP()
         {         
-            Byte[] APPFileData;
-            Byte[] FLASHUBLData;
+            Stream APPFileData;
+            Stream FLASHUBLData;
+            ImageHeader UBLHeader, APPHeader;
+            MagicFlags APPMagic;
+            Int32 appOffset;
 
             // Get Application image data
             APPFileData = GetFileData(cmdParams.APPFileName, cmdParams.APPLoadAddr);
@@ -1079,103 +1580,94 @@ namespace DVFlasher
                 FLASHUBLData = bin2srec(GetEmbeddedUBLStream(), cmdParams.FLASHUBLLoadAddr);
             else
                 FLASHUBLData = GetFileData(cmdParams.FLASHUBLFileName, cmdParams.FLASHUBLLoadAddr);            
+
+            // The flash UBL's entry point goes in the low half of 0x8000xxxx
+            UBLHeader = new ImageHeader((UInt32)cmdParams.FLASHUBLMagicFlag,
+                                        0x80000000 | cmdParams.FLASHUBLExecAddr,
+                                        (UInt32)FLASHUBLData.Length, 0x0000);
+
+            // Magic number of the application as stored in flash
+            if (cmdParams.APPMagicFlag == MagicFlags.UBL_MAGIC_XIP_IMG)
+                APPMagic = MagicFlags.UBL_MAGIC_XIP_IMG;
+            else if ( (cmdParams.CMDMagicFlag == MagicFlags.UBL_MAGIC_NAND_BIN_BURN) ||
+                 (cmdParams.CMDMagicFlag == MagicFlags.UBL_MAGIC_NOR_BIN_BURN) )
+                APPMagic = MagicFlags.UBL_MAGIC_BIN_IMG;
+            else 
+                APPMagic = MagicFlags.UBL_MAGIC_SAFE;
+
+            // Flags 0001: can resume an interrupted transfer
+            APPHeader = new ImageHeader((UInt32)APPMagic, cmdParams.APPEntryPoint,
+                                        (UInt32)APPFileData.Length, 0x0001);
                               
             try
             {
             BOOTPSPSEQ2:
                 
                 // Send the UBL command
-                if (!TransmitCMDSuccessful())
+                if (!TransmitCMDSuccessful(UBLHeader, APPHeader))
                     goto BOOTPSPSEQ2;
 
-                if (waitForSequence("SENDUBL\0", "BOOTPSP\0", MySP))
-                    Console.WriteLine("SENDUBL received. Returning ACK and header for UBL data...");
-                else
+                if (!sendHeader("SENDUBL\0", UBLHeader, cmdParams.Verbose))
                     goto BOOTPSPSEQ2;
 
-                // Output 36 Bytes for the ACK sequence and header
-                // 8 bytes acknowledge sequence = "    ACK\0"
-                MySP.Write("    ACK\0");
-                // 8 bytes of magic number (in this case flash the nor
-                MySP.Write(((UInt32)cmdParams.FLASHUBLMagicFlag).ToString("X8"));
-                // 8 bytes of binary execution address = ASCII string of 8 hex characters
-                MySP.Write("8000");
-                MySP.Write(cmdParams.FLASHUBLExecAddr.ToString("X4"));
-                // 8 bytes of data size = ASCII string of 8 hex characters
-                MySP.Write(((UInt32)FLASHUBLData.Length).ToString("X8"));
-                // 4 bytes of constant zeros = "0000"
-                MySP.Write("0000");
-
-                Console.WriteLine("ACK command sent. Waiting for BEGIN command... ");
+                Console.WriteLine("Waiting for BEGIN command... ");
                 // Wait for the ^^BEGIN\0 sequence
-                if (waitForSequence("  BEGIN\0", "BOOTPSP\0", MySP))
+                if (waitForSequence("  BEGIN\0", "BOOTPSP\0", MySPReader))
                     Console.WriteLine("UART UBL's BEGIN commmand received. Sending the Flash UBL code...");
                 else
                     goto BOOTPSPSEQ2;
 
                 // Send the Flash UBL code (should be in S-record format)
-                MySP.Write(FLASHUBLData, 0, FLASHUBLData.Length);
+                writeStream(FLASHUBLData, 0);
                 Console.WriteLine("Flash UBL code sent.  Waiting for DONE...");
 
                 // Wait for ^^^DONE\0
-                if (waitForSequence("   DONE\0", "BOOTPSP\0", MySP))
+                if (waitForSequence("   DONE\0", "BOOTPSP\0", MySPReader))
                     Console.WriteLine("DONE received.  All bytes of Flash UBL code received...");
                 else
                     goto BOOTPSPSEQ2;
 
                 // Wait for second ^^^DONE\0 to indicate the S-record decode worked
-                if (waitForSequence("   DONE\0", "BOOTPSP\0", MySP))
+                if (waitForSequence("   DONE\0", "BOOTPSP\0", MySPReader))
                     Console.WriteLine("DONE received.  Flash UBL S-record decoded correctly.");
                 else
                     goto BOOTPSPSEQ2;
 
                 // Now Send the Application file that will be written to flash
-                if (waitForSequence("SENDAPP\0", "BOOTPSP\0", MySP,true))
-                    Console.WriteLine("SENDAPP received. Returning ACK and header for application data...");
-                else
+                if (!sendHeader("SENDAPP\0", APPHeader, true))
                     goto BOOTPSPSEQ2;
-                // Output 36 Bytes for the ACK sequence and header
-                // 8 bytes acknowledge sequence = "    ACK\0"
-                MySP.Write("    ACK\0");
-                // 8 bytes of magic number (in this case flash the nor
-                if ( (cmdParams.CMDMagicFlag == MagicFlags.UBL_MAGIC_NAND_BIN_BURN) ||
-                     (cmdParams.CMDMagicFlag == MagicFlags.UBL_MAGIC_NOR_BIN_BURN) )
-                    MySP.Write(((UInt32)MagicFlags.UBL_MAGIC_BIN_IMG).ToString("X8"));
-                else 
-                    MySP.Write(((UInt32)MagicFlags.UBL_MAGIC_SAFE).ToString("X8"));
-
-                // 8 bytes of binary execution address = ASCII string of 8 hex characters
-                MySP.Write(String.Format("{0:X8}", cmdParams.APPEntryPoint));
-                // 8 bytes of data size = ASCII string of 8 hex characters
-                MySP.Write(((UInt32)APPFileData.Length).ToString("X8"));
-                // 4 bytes of constant zeros = "0000"
-                MySP.Write("0000");
 
-                Console.WriteLine("ACK command sent. Waiting for BEGIN command... ");
+                // Agree where to start sending from
+                appOffset = negotiateResume(APPFileData, MySPReader);
+                if (appOffset < 0)
+                    goto BOOTPSPSEQ2;
+
+                Console.WriteLine("Waiting for BEGIN command... ");
                 // Wait for the ^^BEGIN\0 sequence
-                if (waitForSequence("  BEGIN\0", "BOOTPSP\0", MySP))
+                if (waitForSequence("  BEGIN\0", "BOOTPSP\0", MySPReader))
                     Console.WriteLine("UART UBL's BEGIN commmand received. Sending the Application code...");
                 else
                     goto BOOTPSPSEQ2;
 
                 // Send the application code (should be in S-record format)
-                MySP.Write(APPFileData, 0, APPFileData.Length);
+                writeStream(APPFileData, appOffset);
                 Console.WriteLine("Application code sent.  Waiting for DONE...");
 
                 // Wait for ^^^DONE\0
-                if (waitForSequence("   DONE\0", "BOOTPSP\0", MySP))
+                if (waitForSequence("   DONE\0", "BOOTPSP\0", MySPReader))
                     Console.WriteLine("DONE received.  All bytes of Application code received...");
                 else
                     goto BOOTPSPSEQ2;
 
                 // Wait for second ^^^DONE\0 to indicate the S-record decode worked
-                if (waitForSequence("   DONE\0", "BOOTPSP\0", MySP))
+                if (waitForSequence("   DONE\0", "BOOTPSP\0", MySPReader))
                     Console.WriteLine("DONE received.  Application S-record decoded correctly.");
                 else
                     goto BOOTPSPSEQ2;
 
                 // Wait for third ^^^DONE that indicates booting
-                waitForSequence("   DONE\0", "BOOTPSP\0", MySP,true);
+                if (waitForSequence("   DONE\0", "BOOTPSP\0", MySPReader,true))
+                    MyTelemetry.Mark("done");
                                 
             }
             catch (ObjectDisposedException e)
@@ -1183,69 +1675,515 @@ namespace DVFlasher
                 Console.WriteLine(e.StackTrace);
                 throw e;
             }
+            finally
+            {
+                APPFileData.Close();
+                FLASHUBLData.Close();
+            }
 
         }
 
         /// <summary>
-        /// Waitforsequence with option for verbosity
+        /// Read a block range of the flash back from the UBL into the file given
+        /// on the command line.  Pages the UBL left out as erased are filled
+        /// with 0xFF, and every block is checked against the CRC sent with it.
         /// </summary>
-        /// <param name="str">String to look for</param>
-        /// <param name="altStr">String to look for but don't want</param>
-        /// <param name="sp">SerialPort object.</param>
-        /// <param name="verbose">Boolean to indicate verbosity.</param>
-        /// <returns>Boolean to indicate if str or altStr was found.</returns>
-        private static Boolean waitForSequence(String str,String altStr,SerialPort sp,Boolean verbose)
+        private static void ReceiveDump()
         {
-            Boolean strFound = false, altStrFound = false;
-            Byte[] input = new Byte[256];
-            String inputStr;
-            Int32 i;
+            FileStream fs = null;
+            UInt32 numBlocks, blockNum, status, crc, pageSize, numPages;
+            UInt32[] erasedMap;
+            Byte[] blockData;
+            CRC32 MyCRC = new CRC32();
+            Int32 badBlocks = 0;
 
-            while ((!strFound) && (!altStrFound))
+            try
             {
+            BOOTPSPSEQ4:
+                // Send the UBL command
+                if (!TransmitCMDSuccessful())
+                    goto BOOTPSPSEQ4;
+
+                if (!waitForSequence("SENDRNG\0", "BOOTPSP\0", MySPReader))
+                    goto BOOTPSPSEQ4;
 
-                i = 0;
-                do
+                // 8 bytes acknowledge sequence = "    ACK\0"
+                MySP.Write("    ACK\0");
+                // 8 bytes each of first block and block count
+                MySP.Write(cmdParams.DumpStartBlock.ToString("X8"));
+                MySP.Write(cmdParams.DumpNumBlocks.ToString("X8"));
+                // 4 bytes of flags
+                MySP.Write(cmdParams.DumpCompress ? "0001" : "0000");
+
+                if (!waitForSequence("  BEGIN\0", "BOOTPSP\0", MySPReader))
+                    goto BOOTPSPSEQ4;
+                numBlocks = readHexWord(MySPReader);
+                Console.WriteLine("Reading 0x{0:X} blocks...", numBlocks);
+
+                if (fs != null)
+                    fs.Close();
+                fs = File.Open(cmdParams.APPFileName, FileMode.Create, FileAccess.Write);
+
+                for (UInt32 i = 0; i < numBlocks; i++)
                 {
-                    input[i++] = (Byte)sp.ReadByte();
-                    //Console.Write(input[i - 1] + " ");
-                } while ( (input[i - 1] != 0) &&
-                          (i < (input.Length - 1)) &&
-                          (input[i - 1] != 0x0A) &&
-                          (input[i - 1] != 0x0D) );
-
-                // Convert to string for comparison
-                if ((input[i-1] == 0x0A) || (input[i-1] == 0x0D))
-                    inputStr = (new ASCIIEncoding()).GetString(input, 0, i-1);
-                else
-                    inputStr = (new ASCIIEncoding()).GetString(input, 0, i);
+                    if (!waitForSequence("  BLOCK\0", "BOOTPSP\0", MySPReader))
+                        goto BOOTPSPSEQ4;
+
+                    blockNum = readHexWord(MySPReader);
+                    status = readHexWord(MySPReader);
+                    crc = readHexWord(MySPReader);
+                    pageSize = readHexWord(MySPReader);
+                    numPages = readHexWord(MySPReader);
+                    erasedMap = new UInt32[(numPages + 31) / 32];
+                    for (int j = 0; j < erasedMap.Length; j++)
+                        erasedMap[j] = readHexWord(MySPReader);
+
+                    blockData = new Byte[pageSize * numPages];
+                    for (UInt32 page = 0; page < numPages; page++)
+                    {
+                        if ((erasedMap[page / 32] & (1u << (Int32)(page % 32))) != 0)
+                        {
+                            for (UInt32 k = 0; k < pageSize; k++)
+                                blockData[(page * pageSize) + k] = 0xFF;
+                        }
+                        else
+                        {
+                            readBytes(MySPReader, blockData, (Int32)(page * pageSize), (Int32)pageSize);
+                        }
+                    }
+
+                    if (status != 0)
+                    {
+                        Console.WriteLine("Block 0x{0:X}: uncorrectable read error.", blockNum);
+                        badBlocks++;
+                    }
+                    else if (MyCRC.CalculateCRC(blockData) != crc)
+                    {
+                        Console.WriteLine("Block 0x{0:X}: CRC mismatch, data damaged in transfer.", blockNum);
+                        badBlocks++;
+                    }
+                    else if (cmdParams.Verbose)
+                    {
+                        Console.WriteLine("Block 0x{0:X} read.", blockNum);
+                    }
+
+                    fs.Write(blockData, 0, blockData.Length);
+                }
+
+                if (!waitForSequence("   DONE\0", "BOOTPSP\0", MySPReader, true))
+                    goto BOOTPSPSEQ4;
+                MyTelemetry.Mark("done");
+
+                fs.Close();
+                if (badBlocks != 0)
+                    throw new Exception(badBlocks + " block(s) of the dump are not reliable.");
+                Console.WriteLine("Dump written to " + cmdParams.APPFileName + ".");
+            }
+            catch (ObjectDisposedException e)
+            {
+                Console.WriteLine(e.StackTrace);
+                throw e;
+            }
+        }
+
+        /// <summary>
+        /// Check a block range of the flash against the image file given on the
+        /// command line.  Only the CRC-32 of each block goes over the wire; the
+        /// UBL computes the flash side itself and names the blocks that differ.
+        /// Blocks past the end of the image are expected to be erased.
+        /// </summary>
+        private static void VerifyFlash()
+        {
+            FileStream golden;
+            UInt32[] blockSizes, blockCRCs;
+            UInt32 numBlocks, blockNum, crc, numBad;
+            StringBuilder crcSB;
+
+            if (!File.Exists(cmdParams.APPFileName))
+            {
+                throw new FileNotFoundException("File " + cmdParams.APPFileName + " is not present.");
+            }
+            golden = File.Open(cmdParams.APPFileName, FileMode.Open, FileAccess.Read);
+
+            try
+            {
+            BOOTPSPSEQ5:
+                // Send the UBL command
+                if (!TransmitCMDSuccessful())
+                    goto BOOTPSPSEQ5;
 
-                if (inputStr.Length == 0)
+                if (!waitForSequence("SENDRNG\0", "BOOTPSP\0", MySPReader))
+                    goto BOOTPSPSEQ5;
+
+                // 8 bytes acknowledge sequence = "    ACK\0"
+                MySP.Write("    ACK\0");
+                // 8 bytes each of first block and block count
+                MySP.Write(cmdParams.DumpStartBlock.ToString("X8"));
+                MySP.Write(cmdParams.DumpNumBlocks.ToString("X8"));
+                // 4 bytes of flags
+                MySP.Write("0000");
+
+                // Get the size of each block in the range
+                if (!waitForSequence("SENDCRC\0", "BOOTPSP\0", MySPReader))
+                    goto BOOTPSPSEQ5;
+                numBlocks = readHexWord(MySPReader);
+                blockSizes = new UInt32[numBlocks];
+                for (int i = 0; i < blockSizes.Length; i++)
+                    blockSizes[i] = readHexWord(MySPReader);
+
+                // Get the expected CRC of each block of the image
+                blockCRCs = getBlockCRCs(golden, blockSizes);
+                crcSB = new StringBuilder(blockCRCs.Length * 8);
+                for (int i = 0; i < blockCRCs.Length; i++)
+                    crcSB.AppendFormat("{0:X8}", blockCRCs[i]);
+
+                Console.WriteLine("Sending 0x{0:X} block CRCs...", numBlocks);
+                // 8 bytes acknowledge sequence = "    ACK\0"
+                MySP.Write("    ACK\0");
+                MySP.Write(crcSB.ToString());
+
+                // Collect the mismatches until the UBL is done
+                while (waitForSequence("MISMTCH\0", "   DONE\0", MySPReader))
                 {
-                    continue;
+                    blockNum = readHexWord(MySPReader);
+                    crc = readHexWord(MySPReader);
+                    Console.WriteLine("Block 0x{0:X} does not match (CRC {1:X8}).", blockNum, crc);
                 }
+                numBad = readHexWord(MySPReader);
+                MyTelemetry.Mark("done");
 
-                // Compare Strings to see what came back
-                if (verbose)
-                    Console.WriteLine("\tDVEVM:\t{0}", inputStr);
-                if (inputStr.Contains(altStr))
+                if (numBad != 0)
+                    throw new Exception(numBad + " block(s) of the flash differ from the image.");
+                Console.WriteLine("All 0x{0:X} blocks match the image.", numBlocks);
+            }
+            catch (ObjectDisposedException e)
+            {
+                Console.WriteLine(e.StackTrace);
+                throw e;
+            }
+            finally
+            {
+                golden.Close();
+            }
+        }
+
+        /// <summary>
+        /// Work out the CRC-32 of each block of an image, as it would read back
+        /// from flash blocks of the given sizes (erased past the end of the
+        /// image).  The results are kept in the image cache for the next board.
+        /// </summary>
+        /// <param name="image">The image file.</param>
+        /// <param name="blockSizes">Size of each block, in order.</param>
+        /// <returns>CRC of each block.</returns>
+        private static UInt32[] getBlockCRCs(FileStream image, UInt32[] blockSizes)
+        {
+            UInt32[] crcs = null;
+            String key = null;
+            Byte[] blockData;
+            Int64 total = 0;
+            Int32 len, n;
+            CRC32 MyCRC = new CRC32();
+            ImageCache cache = MyCache;
+
+            for (int i = 0; i < blockSizes.Length; i++)
+                total += blockSizes[i];
+            if (total < image.Length)
+                Console.WriteLine("WARNING! The image is larger than the range checked.");
+
+            if (cache != null)
+            {
+                try
                 {
-                    altStrFound = true;
-                    if (String.Equals(str, altStr))
-                    {
-                        strFound = altStrFound;
-                    }
+                    key = cache.GetKey(image);
+                    crcs = cache.GetBlockCRCs(key, blockSizes);
                 }
-                else if (inputStr.Contains(str))
+                catch (IOException e)
                 {
-                    strFound = true;
+                    cacheFailed(e);
                 }
-                else
+                catch (UnauthorizedAccessException e)
+                {
+                    cacheFailed(e);
+                }
+                if (crcs != null)
+                {
+                    Console.WriteLine("Using block CRCs from the cache.");
+                    return crcs;
+                }
+            }
+
+            crcs = new UInt32[blockSizes.Length];
+            image.Position = 0;
+            for (int i = 0; i < blockSizes.Length; i++)
+            {
+                blockData = new Byte[blockSizes[i]];
+                for (len = 0; len < blockData.Length; len += n)
                 {
-                    strFound = false;
+                    n = image.Read(blockData, len, blockData.Length - len);
+                    if (n <= 0)
+                        break;
                 }
+                for (; len < blockData.Length; len++)
+                    blockData[len] = 0xFF;
+                crcs[i] = MyCRC.CalculateCRC(blockData);
             }
-            return strFound;
+
+            if ((cache != null) && (key != null))
+            {
+                try
+                {
+                    cache.StoreBlockCRCs(key, blockSizes, crcs);
+                }
+                catch (IOException e)
+                {
+                    cacheFailed(e);
+                }
+                catch (UnauthorizedAccessException e)
+                {
+                    cacheFailed(e);
+                }
+            }
+
+            return crcs;
+        }
+
+        /// <summary>
+        /// Stop using the image cache after an error in it; flashing carries on
+        /// without it.
+        /// </summary>
+        /// <param name="e">The error.</param>
+        private static void cacheFailed(Exception e)
+        {
+            Console.WriteLine("WARNING! Image cache disabled: " + e.Message);
+            MyCache = null;
+        }
+
+        /// <summary>
+        /// Send a prepared image over the serial port, from the given offset to
+        /// its end, a chunk at a time as it is read or encoded.  Each write
+        /// blocks until the driver has room for it, which keeps its queue full
+        /// (and, with -rtscts, paced by the UBL).  Throughput and time left are
+        /// reported as the chunks go out.
+        /// </summary>
+        /// <param name="data">The image to send.</param>
+        /// <param name="offset">Where in the image to start.</param>
+        private static void writeStream(Stream data, Int64 offset)
+        {
+            writeStream(data, offset, false);
+        }
+
+        /// <summary>
+        /// Send a prepared image, as writeStream(data, offset) does
+        /// </summary>
+        /// <param name="data">The image to send.</param>
+        /// <param name="offset">Where in the image to start.</param>
+        /// <param name="hexText">Whether data is a binary written out as hex
+        /// digits, two for each byte of image (for the telemetry).</param>
+        private static void writeStream(Stream data, Int64 offset, Boolean hexText)
+        {
+            Byte[] chunk = new Byte[cmdParams.WriteChunkSize];
+            Int64 total = data.Length - offset, sent = 0, payload;
+            Int32 n, start, now, lastReport;
+            SrecStream srec = data as SrecStream;
+            SrecStream.RecordCounter records = null;
+
+            // An S-record file sent as it is has its data bytes counted on the
+            // way out; an SrecStream knows its binary length
+            if ((srec == null) && !hexText && (data.Length >= 2))
+            {
+                data.Position = 0;
+                if ((data.ReadByte() == 'S') && (data.ReadByte() == '0'))
+                    records = new SrecStream.RecordCounter(offset == 0);
+            }
+
+            data.Position = offset;
+            start = lastReport = now = Environment.TickCount;
+            while ((n = data.Read(chunk, 0, chunk.Length)) > 0)
+            {
+                MySP.Write(chunk, 0, n);
+                sent += n;
+                if (records != null)
+                    records.Add(chunk, n);
+
+                now = Environment.TickCount;
+                if (((now - lastReport) >= 500) || (sent == total))
+                {
+                    reportProgress(sent, total, now - start);
+                    lastReport = now;
+                }
+            }
+            Console.WriteLine();
+
+            if (srec != null)
+                payload = (srec.Length > 0) ? ((srec.PayloadLength * sent) / srec.Length) : 0;
+            else if (records != null)
+                payload = records.DataBytes;
+            else if (hexText)
+                payload = sent / 2;
+            else
+                payload = sent;
+            MyTelemetry.AddTransfer(sent, payload, now - start);
+        }
+
+        /// <summary>
+        /// Show how much of a transfer has gone out, the rate and the time left
+        /// </summary>
+        /// <param name="sent">Bytes sent so far.</param>
+        /// <param name="total">Bytes to send in all.</param>
+        /// <param name="elapsedMs">Milliseconds since the transfer started.</param>
+        private static void reportProgress(Int64 sent, Int64 total, Int32 elapsedMs)
+        {
+            Double rate = (elapsedMs > 0) ? ((sent * 1000.0) / elapsedMs) : 0.0;
+            Int64 left = (rate > 0.0) ? (Int64)((total - sent) / rate) : 0;
+
+            Console.Write("\r\t0x{0:X8} of 0x{1:X8} bytes, {2,7:F1} kB/s, {3}:{4:D2} left ",
+                          sent, total, rate / 1024.0, left / 60, left % 60);
+        }
+
+        /// <summary>
+        /// Record a UBL phase marker, and report the flash throughput of the
+        /// phase it ends
+        /// </summary>
+        /// <param name="phase">UART_PHASE_* value sent by the UBL.</param>
+        public static void OnUBLPhase(UInt32 phase)
+        {
+            String report = MyTelemetry.MarkUBLPhase(phase);
+
+            if (report != null)
+            {
+                Console.WriteLine();
+                Console.WriteLine("\tFlash " + report);
+            }
+        }
+
+        /// <summary>
+        /// Record a progress frame from the UBL and redraw the progress bar
+        /// </summary>
+        /// <param name="p">The frame.</param>
+        public static void OnFlashProgress(FlashProgress p)
+        {
+            const Int32 barWidth = 30;
+            Double seconds, rate;
+            Int32 filled;
+
+            MyTelemetry.AddFlashProgress(p);
+
+            // Nothing to program yet: the phase is erasing
+            if (p.BytesTotal == 0)
+            {
+                Console.Write("\r\t{0} block(s) erased ", p.BlocksErased);
+                return;
+            }
+
+            seconds = MyTelemetry.FlashSeconds;
+            rate = (seconds > 0.0) ? (p.BytesWritten / seconds) : 0.0;
+            filled = (Int32)Math.Min((Int64)barWidth, ((Int64)p.BytesWritten * barWidth) / p.BytesTotal);
+
+            Console.Write("\r\t[{0}{1}] {2,3}% 0x{3:X8} of 0x{4:X8} bytes, {5,7:F1} kB/s ",
+                          new String('#', filled), new String('-', barWidth - filled),
+                          ((Int64)p.BytesWritten * 100) / p.BytesTotal,
+                          p.BytesWritten, p.BytesTotal, rate / 1024.0);
+        }
+
+        /// <summary>
+        /// Read an exact number of bytes from the serial port
+        /// </summary>
+        /// <param name="sr">SerialReader object.</param>
+        /// <param name="buffer">Destination array.</param>
+        /// <param name="offset">Where in the array to start.</param>
+        /// <param name="count">Number of bytes to read.</param>
+        private static void readBytes(SerialReader sr, Byte[] buffer, Int32 offset, Int32 count)
+        {
+            sr.Read(buffer, offset, count);
+        }
+
+        /// <summary>
+        /// Answer the UBL's resume offer for an application transfer.  The UBL
+        /// reports how much of this data it already holds from an interrupted
+        /// attempt and the CRC-32 of those bytes; if the CRC matches our own
+        /// copy we carry on from there, otherwise we start over.
+        /// </summary>
+        /// <param name="data">The data about to be sent.</param>
+        /// <param name="sr">SerialReader object.</param>
+        /// <returns>Offset to send the data from, or -1 if the UBL restarted.</returns>
+        private static Int32 negotiateResume(Stream data, SerialReader sr)
+        {
+            UInt32 offset, crc;
+            CRC32 MyCRC;
+
+            if (!waitForSequence(" RESUME\0", "BOOTPSP\0", sr))
+                return -1;
+
+            offset = readHexWord(sr);
+            crc = readHexWord(sr);
+
+            if ((offset != 0) && (offset <= data.Length))
+            {
+                data.Position = 0;
+                MyCRC = new CRC32();
+                if (MyCRC.CalculateCRC(data, offset) == crc)
+                    Console.WriteLine("Resuming the transfer at byte 0x{0:X8}.", offset);
+                else
+                    offset = 0;
+            }
+            else
+            {
+                offset = 0;
+            }
+
+            // 8 bytes acknowledge sequence = "    ACK\0"
+            sr.Port.Write("    ACK\0");
+            // 8 bytes of offset to send from = ASCII string of 8 hex characters
+            sr.Port.Write(offset.ToString("X8"));
+
+            return (Int32)offset;
+        }
+
+        /// <summary>
+        /// Read a 32-bit value sent as 8 hex characters
+        /// </summary>
+        /// <param name="sr">SerialReader object.</param>
+        /// <returns>The value read.</returns>
+        private static UInt32 readHexWord(SerialReader sr)
+        {
+            return sr.ReadHexWord();
+        }
+
+        /// <summary>
+        /// Waitforsequence with option for verbosity
+        /// </summary>
+        /// <param name="str">String to look for</param>
+        /// <param name="altStr">String to look for but don't want</param>
+        /// <param name="sr">SerialReader object.</param>
+        /// <param name="verbose">Boolean to indicate verbosity.</param>
+        /// <returns>Boolean to indicate if str or altStr was found.</returns>
+        private static Boolean waitForSequence(String str,String altStr,SerialReader sr,Boolean verbose)
+        {
+            Boolean found = waitForSequenceOnce(str, altStr, sr, verbose);
+
+            // Any answer but a restart means the UBL took the command frame
+            if (found && !String.Equals(str, "BOOTPSP\0"))
+                frameUnconfirmed = false;
+            return found;
+        }
+
+        private static Boolean waitForSequenceOnce(String str,String altStr,SerialReader sr,Boolean verbose)
+        {
+            String pending = pendingSequence;
+
+            // The station may have received this one already
+            pendingSequence = null;
+            if ((pending != null) && (String.Equals(pending, str) || String.Equals(pending, altStr)))
+                return String.Equals(pending, str);
+
+            if (String.Equals(str, altStr))
+            {
+                sr.WaitFor(verbose, str);
+                return true;
+            }
+
+            // altStr goes first so that it wins if both end on the same byte
+            return (sr.WaitFor(verbose, altStr, str) == 1);
         }
 
 
@@ -1255,11 +2193,11 @@ namespace DVFlasher
         /// <param name="str">Expected character string.</param>
         /// <param name="altStr">Alternative string that if received, indicates failure
         /// This is "BOOTME\0" or "BOOTPSP\0"</param>
-        /// <param name="sp">Serial port object to use to receive string.</param>
+        /// <param name="sr">Buffered reader of the serial port to receive the string on.</param>
         /// <returns>Boolean ind4cating whether sequence was received.</returns>
-        private static Boolean waitForSequence( String str,String altStr,SerialPort sp)
+        private static Boolean waitForSequence( String str,String altStr,SerialReader sr)
         {
-            return waitForSequence(str, altStr, sp, cmdParams.Verbose);
+            return waitForSequence(str, altStr, sr, cmdParams.Verbose);
         }
         
         #endregion 
@@ -1270,186 +2208,116 @@ namespace DVFlasher
         #region Code to manipulate binary file to Motorola S-record
 
         /// <summary>
-        /// Function to convert the input filestream into an byte array in S-record format,
-        /// so that it can be downloaded to the EVM board.
+        /// Function to present the input stream as S-records, so that it can be
+        /// downloaded to the EVM board.  The records are encoded as they are read.
         /// </summary>
-        /// <param name="inputFileStream">The input filestream that encapsulates the
+        /// <param name="inputStream">The input stream that encapsulates the
         /// input application file.</param>
         /// <param name="startAddr">The starting address of the RAM location where the binary data
         /// encapsulated by the S-record will be stored.</param>
-        /// <returns>A byte array of the file data.</returns>
-        public static Byte[] bin2srec(Stream inputStream, UInt32 startAddr)
+        /// <returns>A stream of the S-record text.</returns>
+        public static Stream bin2srec(Stream inputStream, UInt32 startAddr)
         {
-            Int64 totalLen;
-            BinaryReader fileBR = new BinaryReader(inputStream);
-            StringBuilder fileSB;
             String fileName;
             String shortFileName;
-            Byte[] currChar = new Byte[1];
-            Byte[] currDataRecord;
-            Int32 i, checksum8 = 0;
-            Int32 recordSize = 16;
-            UInt32 memAddr = startAddr;
-            
-            // Set the actual length
-            totalLen = fileBR.BaseStream.Length;
-            fileSB = new StringBuilder(4 * (int)totalLen);
-            
+
             // Set S-record filename (real name or fake)
             if (inputStream is FileStream)
                 fileName = ((FileStream)inputStream).Name;
             else
-                fileName = "ublDaVinci.bin";            
-                        
-            fileBR.BaseStream.Seek(0x0, SeekOrigin.Begin);
-            
+                fileName = "ublDaVinci.bin";
+
             // Get filename (this is S-record module name)
             if (Path.HasExtension(fileName))
                 shortFileName = Path.GetFileNameWithoutExtension(fileName) + ".srec";
             else
                 shortFileName = Path.GetFileName(fileName) + ".srec";
-                                    
-            // Make sure S-record module name fits in 20 byte field
-            if (shortFileName.Length > 20)
-                shortFileName = shortFileName.Substring(0, 20);
-
-            // Create first s-record (S0 record)
-            fileSB.Append("S0");
-            // Write length field
-            fileSB.AppendFormat("{0:X2}",shortFileName.Length+3);
-            checksum8 += (Byte)(shortFileName.Length + 3);
-            // Write address field
-            fileSB.Append("0000");
-            // Write name field
-            for (i = 0; i < shortFileName.Length; i++)
-            {
-                currChar = (new ASCIIEncoding()).GetBytes(shortFileName.Substring(i, 1));
-                checksum8 += currChar[0];                
-                fileSB.AppendFormat("{0:X2}",currChar[0]);
-            }
-            // Write Checksum field
-            fileSB.AppendFormat("{0:X2}\x0A", ((checksum8&0xFF)^0xFF));
-
-            // Write collection of S3 records (actual binary data)
-            i = (Int32)totalLen;
-            
-            while (i >= recordSize)
-            {
-                checksum8 = 0;
-                // Write S3 record label
-                fileSB.Append("S3");
-                // Write length field (4 address bytes + 16 data bytes + 1 checksum byte)
-                fileSB.AppendFormat("{0:X2}", recordSize + 5);
-                checksum8 += (recordSize + 5);
-                
-                // Write address field and update it
-                fileSB.AppendFormat("{0:X8}", memAddr);
-                currDataRecord = System.BitConverter.GetBytes(memAddr);
-                for (int j = 0; j < 4; j++)
-                {
-                    checksum8 += currDataRecord[j];
-                }
-                
-                // Write out the bytes of data
-                currDataRecord = fileBR.ReadBytes(recordSize);
-                for (int j = 0; j < recordSize; j++)
-                {                    
-                    fileSB.AppendFormat("{0:X2}", currDataRecord[j]);
-                    checksum8 += currDataRecord[j];
-                }
-                //Write out checksum and linefeed character
-                fileSB.AppendFormat("{0:X2}\x0A", ((checksum8&0xFF) ^ 0xFF));
 
-                memAddr += (UInt32)recordSize; i -= recordSize;
-            }
-
-            // Finish out the record if anything is left over
-            if (i > 0)
-            {
-                checksum8 = 0;
-                // Write S3 record label
-                fileSB.Append("S3");
-                // Write length field (4 address bytes + 16 data bytes + 1 checksum byte)
-                fileSB.AppendFormat("{0:X2}", i + 5);
-                checksum8 += (i + 5);
+            return new SrecStream(inputStream, startAddr, shortFileName);
+        }
 
-                // Write address field and update it
-                fileSB.AppendFormat("{0:X8}", memAddr);
-                currDataRecord = System.BitConverter.GetBytes(memAddr);
-                for (int j = 0; j < 4; j++)
-                {
-                    checksum8 += currDataRecord[j];
-                }
+        /// <summary>
+        /// Read a little-endian 32-bit word from a file header
+        /// </summary>
+        /// <param name="inputFileStream">The input filestream.</param>
+        /// <param name="offset">Byte offset of the word in the file.</param>
+        /// <returns>The word read.</returns>
+        public static UInt32 readWordAt(FileStream inputFileStream, Int64 offset)
+        {
+            Byte[] word = new Byte[4];
 
-                // Write out the bytes of data
-                currDataRecord = fileBR.ReadBytes(i);
-                for (int j = 0; j < i; j++)
-                {
-                    fileSB.AppendFormat("{0:X2}", currDataRecord[j]);
-                    checksum8 += currDataRecord[j];
-                }
-                //Write out checksum and linefeed character
-                fileSB.AppendFormat("{0:X2}\x0A", ((checksum8 & 0xFF) ^ 0xFF));
+            inputFileStream.Position = offset;
+            if (inputFileStream.Read(word, 0, word.Length) != word.Length)
+                throw new EndOfStreamException("File " + inputFileStream.Name + " is too short.");
 
-                memAddr += (UInt32)i; i = 0;
+            return System.BitConverter.ToUInt32(word, 0);
+        }
+        
+        /// <summary>
+        /// Check to see if filestream is an ELF32 little endian ARM executable
+        /// </summary>
+        /// <param name="inputFileStream">The input filestream that encapsulates the
+        /// input application file.</param>
+        /// <returns>a boolean representing whether the file is an ELF image.</returns>
+        public static Boolean isFileElf(FileStream inputFileStream)
+        {
+            Byte[] ident = new Byte[20];
 
-            }
-            
-            // Write out the final record (S7 record)
-            checksum8 = 0;
-            // Write S7 record label
-            fileSB.Append("S7");
-            // Write length field (4 address bytes + 1 checksum byte)
-            fileSB.AppendFormat("{0:X2}", 5);
-            checksum8 += 5;
-
-            // Write execution start address field and update it
-            fileSB.AppendFormat("{0:X8}", startAddr);
-            currDataRecord = System.BitConverter.GetBytes(startAddr);
-            for (int j = 0; j < 4; j++)
-            {
-                checksum8 += currDataRecord[j];
-            }
-            //Write out checksum and linefeed character
-            fileSB.AppendFormat("{0:X2}\x0A", ((checksum8 & 0xFF) ^ 0xFF));
+            inputFileStream.Position = 0;
+            if (inputFileStream.Read(ident, 0, ident.Length) != ident.Length)
+                return false;
 
-            return (new ASCIIEncoding()).GetBytes(fileSB.ToString());
-        
+            return ( (ident[0] == 0x7F) && (ident[1] == (Byte)'E') && (ident[2] == (Byte)'L') &&
+                     (ident[3] == (Byte)'F') && (ident[4] == 1) && (ident[5] == 1) &&
+                     (ident[18] == 40) );
         }
 
         /// <summary>
-        /// Get the byte array if the file is already an S-record
+        /// Check to see if filestream is a UBL boot container (starts with "UBLC")
         /// </summary>
         /// <param name="inputFileStream">The input filestream that encapsulates the
         /// input application file.</param>
-        /// <returns>A byte array of the file data.</returns>
-        public static Byte[] readSrec(FileStream inputFileStream)
+        /// <returns>a boolean representing whether the file is a boot container.</returns>
+        public static Boolean isFileContainer(FileStream inputFileStream)
         {
+            Byte[] magic = new Byte[4];
+
             inputFileStream.Position = 0;
-            return (new BinaryReader(inputFileStream)).ReadBytes((Int32)inputFileStream.Length);
+            if (inputFileStream.Read(magic, 0, magic.Length) != magic.Length)
+                return false;
+
+            return (Encoding.ASCII.GetString(magic) == "UBLC");
         }
-        
+
         /// <summary>
-        /// Check to see if filestream is an S-record by reading the first
-        /// character of each line and seeing if it is 'S'
+        /// Check to see if filestream is an S-record by looking at the start of
+        /// the file: it must begin with an 'S' record type and hold nothing but
+        /// record characters and line breaks.
         /// </summary>
         /// <param name="inputFileStream">The input filestream that encapsulates the
         /// input application file.</param>
         /// <returns>a boolean representing whether the file is an s-record.</returns>
         public static Boolean isFileSrec(FileStream inputFileStream)
         {
-            StreamReader sr = new StreamReader(inputFileStream, Encoding.ASCII);
-            String text;
+            Byte[] text = new Byte[512];
+            Int32 len;
+            Byte c;
 
             inputFileStream.Position = 0;
-            text = sr.ReadLine();
-            while (!sr.EndOfStream)
+            len = inputFileStream.Read(text, 0, text.Length);
+            if ((len < 2) || (text[0] != (Byte)'S') || (text[1] < (Byte)'0') || (text[1] > (Byte)'9'))
+                return false;
+
+            for (Int32 i = 0; i < len; i++)
             {
-                if (!text.StartsWith("S"))
+                c = text[i];
+                if ( !( ((c >= (Byte)'0') && (c <= (Byte)'9')) ||
+                        ((c >= (Byte)'A') && (c <= (Byte)'F')) ||
+                        ((c >= (Byte)'a') && (c <= (Byte)'f')) ||
+                        (c == (Byte)'S') || (c == 0x0A) || (c == 0x0D) ) )
                 {
                     return false;
                 }
-                text = sr.ReadLine();
             }
             
             return true;
@@ -0,0 +1,76 @@
+/****************************************************************
+ *  DVEVM Serial Boot/Flash Host Program - Progress frames      *
+ ****************************************************************/
+
+using System;
+
+namespace DVFlasher
+{
+    /// <summary>
+    /// One progress frame sent by the UBL during flash work (UART_PROGRESS in
+    /// the UBL's uart.h).  The frame follows "PROGRES\0" as 20 raw
+    /// little-endian bytes, and its counts run from the last phase marker.
+    /// </summary>
+    public class FlashProgress
+    {
+        #region Data members
+
+        /// <summary>
+        /// Size of a frame on the wire, after its sequence
+        /// </summary>
+        public const Int32 Size = 20;
+
+        /// <summary>
+        /// Rate of the UBL's TIMER1, which the ticks are counted in
+        /// </summary>
+        public const Double TicksPerSecond = 27000000.0;
+
+        public UInt32 BytesWritten;
+        public UInt32 BytesTotal;
+        public UInt16 BlocksErased;
+        public UInt16 PagesWritten;
+        public UInt16 ECCFixes;
+        public UInt16 Retries;
+
+        /// <summary>
+        /// Timer ticks since the previous frame (or the phase marker)
+        /// </summary>
+        public UInt32 Ticks;
+
+        #endregion
+
+        #region Constructors
+
+        /// <summary>
+        /// Decode a frame
+        /// </summary>
+        /// <param name="frame">The Size bytes of the frame.</param>
+        public FlashProgress(Byte[] frame)
+        {
+            BytesWritten = GetUInt32(frame, 0);
+            BytesTotal   = GetUInt32(frame, 4);
+            BlocksErased = GetUInt16(frame, 8);
+            PagesWritten = GetUInt16(frame, 10);
+            ECCFixes     = GetUInt16(frame, 12);
+            Retries      = GetUInt16(frame, 14);
+            Ticks        = GetUInt32(frame, 16);
+        }
+
+        #endregion
+
+        #region Private Methods
+
+        // The frame is little-endian whatever the host is
+        private static UInt16 GetUInt16(Byte[] b, Int32 offset)
+        {
+            return (UInt16)(b[offset] | (b[offset + 1] << 8));
+        }
+
+        private static UInt32 GetUInt32(Byte[] b, Int32 offset)
+        {
+            return (UInt32)GetUInt16(b, offset) | ((UInt32)GetUInt16(b, offset + 2) << 16);
+        }
+
+        #endregion
+    }
+}
@@ -0,0 +1,287 @@
+/****************************************************************
+ *  DVEVM Serial Boot/Flash Host Program - Image cache          *
+ ****************************************************************/
+
+using System;
+using System.Text;
+using System.IO;
+using System.Collections.Generic;
+using System.Security.Cryptography;
+
+namespace DVFlasher
+{
+    /// <summary>
+    /// On-disk cache of the per-block CRCs used when verifying flash against
+    /// an image, shared by every run and every port.  Entries are keyed by the
+    /// SHA-1 of the image's contents; an index of path, length and modification
+    /// time lets an unchanged file find its key without being read again.
+    /// Both the index and the entries are kept to a fixed number, dropping the
+    /// least recently used.
+    /// </summary>
+    public class ImageCache
+    {
+        #region Data members
+
+        // Most files the index remembers, and most block CRC entries kept
+        public const Int32 MaxIndexEntries = 256;
+        public const Int32 MaxEntries = 64;
+
+        private String cacheDir;
+        private String indexFile;
+
+        // "path|length|ticks" -> content hash, and the ids oldest first
+        private Dictionary<String, String> index = new Dictionary<String, String>();
+        private List<String> indexOrder = new List<String>();
+
+        #endregion
+
+        #region Constructors
+
+        /// <summary>
+        /// Open (creating if needed) the cache in the given directory
+        /// </summary>
+        /// <param name="dir">Directory holding the cache.</param>
+        public ImageCache(String dir)
+        {
+            String line;
+            String[] fields;
+
+            cacheDir = dir;
+            indexFile = Path.Combine(dir, "index.txt");
+            Directory.CreateDirectory(dir);
+
+            if (File.Exists(indexFile))
+            {
+                using (StreamReader sr = new StreamReader(indexFile, Encoding.UTF8))
+                {
+                    while ((line = sr.ReadLine()) != null)
+                    {
+                        fields = line.Split(new Char[] { '\t' }, 4);
+                        if (fields.Length == 4)
+                            AddToIndex(fields[3] + "|" + fields[1] + "|" + fields[2], fields[0]);
+                    }
+                }
+            }
+        }
+
+        #endregion
+
+        #region Properties
+
+        /// <summary>
+        /// Default cache location, under the user's local application data
+        /// </summary>
+        public static String DefaultDirectory
+        {
+            get
+            {
+                return Path.Combine(
+                    Environment.GetFolderPath(Environment.SpecialFolder.LocalApplicationData),
+                    "DVFlasher" + Path.DirectorySeparatorChar + "cache");
+            }
+        }
+
+        #endregion
+
+        #region Public Methods
+
+        /// <summary>
+        /// Get the content key of a file, hashing it only if the index has no
+        /// entry for its current path, length and modification time
+        /// </summary>
+        /// <param name="fs">The open file.</param>
+        /// <returns>Hex SHA-1 of the file contents.</returns>
+        public String GetKey(FileStream fs)
+        {
+            FileInfo fi = new FileInfo(fs.Name);
+            String id = fi.FullName + "|" + fi.Length.ToString() + "|" + fi.LastWriteTimeUtc.Ticks.ToString();
+            String key;
+            Byte[] hash;
+            StringBuilder sb;
+
+            lock (index)
+            {
+                if (index.TryGetValue(id, out key))
+                    return key;
+            }
+
+            fs.Position = 0;
+            hash = SHA1.Create().ComputeHash(fs);
+            fs.Position = 0;
+
+            sb = new StringBuilder(hash.Length * 2);
+            foreach (Byte b in hash)
+                sb.AppendFormat("{0:x2}", b);
+            key = sb.ToString();
+
+            // Sessions on a station share the cache
+            lock (index)
+            {
+                if (AddToIndex(id, key))
+                    WriteIndex();
+                else
+                    File.AppendAllText(indexFile, IndexLine(id, key) + "\n", Encoding.UTF8);
+            }
+
+            return key;
+        }
+
+        /// <summary>
+        /// Look up the CRC-32 of each block of an entry for a given block layout
+        /// </summary>
+        /// <param name="key">Content key of the image.</param>
+        /// <param name="blockSizes">Size of each block, in order.</param>
+        /// <returns>The CRCs, or null if this layout is not cached.</returns>
+        public UInt32[] GetBlockCRCs(String key, UInt32[] blockSizes)
+        {
+            String name = BlockCRCFile(key, blockSizes);
+            String[] lines;
+            UInt32[] crcs;
+
+            if (!File.Exists(name))
+                return null;
+
+            lines = File.ReadAllLines(name);
+            if (lines.Length != blockSizes.Length)
+                return null;
+
+            // The write time is the entry's last use, for eviction
+            File.SetLastWriteTimeUtc(name, DateTime.UtcNow);
+
+            crcs = new UInt32[lines.Length];
+            for (Int32 i = 0; i < lines.Length; i++)
+                crcs[i] = UInt32.Parse(lines[i], System.Globalization.NumberStyles.AllowHexSpecifier);
+
+            return crcs;
+        }
+
+        /// <summary>
+        /// Remember the CRC-32 of each block of an entry for a given block layout
+        /// </summary>
+        /// <param name="key">Content key of the image.</param>
+        /// <param name="blockSizes">Size of each block, in order.</param>
+        /// <param name="crcs">CRC of each block.</param>
+        public void StoreBlockCRCs(String key, UInt32[] blockSizes, UInt32[] crcs)
+        {
+            String name = BlockCRCFile(key, blockSizes);
+            String temp = name + "." + Guid.NewGuid().ToString("N");
+            String[] lines = new String[crcs.Length];
+
+            for (Int32 i = 0; i < crcs.Length; i++)
+                lines[i] = crcs[i].ToString("X8");
+
+            File.WriteAllLines(temp, lines);
+            try
+            {
+                File.Move(temp, name);
+            }
+            catch (IOException)
+            {
+                File.Delete(temp);
+            }
+
+            Evict();
+        }
+
+        #endregion
+
+        #region Private Methods
+
+        /// <summary>
+        /// Add or refresh an index entry, dropping the oldest ones past
+        /// MaxIndexEntries
+        /// </summary>
+        /// <returns>Whether any entry was dropped or replaced, in which case the
+        /// index file has to be written out again rather than appended to.</returns>
+        private Boolean AddToIndex(String id, String key)
+        {
+            Boolean rewrite = indexOrder.Remove(id);
+
+            index[id] = key;
+            indexOrder.Add(id);
+            while (indexOrder.Count > MaxIndexEntries)
+            {
+                index.Remove(indexOrder[0]);
+                indexOrder.RemoveAt(0);
+                rewrite = true;
+            }
+            return rewrite;
+        }
+
+        /// <summary>
+        /// Index file line of an entry: key, length, ticks and path
+        /// </summary>
+        private String IndexLine(String id, String key)
+        {
+            String[] parts = id.Split('|');
+            Int32 n = parts.Length;
+
+            // The path itself may contain '|'
+            return key + "\t" + parts[n - 2] + "\t" + parts[n - 1] + "\t" +
+                   id.Substring(0, id.Length - parts[n - 2].Length - parts[n - 1].Length - 2);
+        }
+
+        /// <summary>
+        /// Write out the whole index, under a private name first so that another
+        /// instance never reads half of it
+        /// </summary>
+        private void WriteIndex()
+        {
+            String temp = indexFile + "." + Guid.NewGuid().ToString("N");
+            String[] lines = new String[indexOrder.Count];
+
+            for (Int32 i = 0; i < lines.Length; i++)
+                lines[i] = IndexLine(indexOrder[i], index[indexOrder[i]]);
+
+            File.WriteAllLines(temp, lines, Encoding.UTF8);
+            File.Delete(indexFile);
+            File.Move(temp, indexFile);
+        }
+
+        /// <summary>
+        /// Delete the least recently used entries past MaxEntries
+        /// </summary>
+        private void Evict()
+        {
+            String[] names = Directory.GetFiles(cacheDir, "*_blocks_*");
+            DateTime[] used;
+
+            if (names.Length <= MaxEntries)
+                return;
+
+            used = new DateTime[names.Length];
+            for (Int32 i = 0; i < names.Length; i++)
+                used[i] = File.GetLastWriteTimeUtc(names[i]);
+            Array.Sort(used, names);
+
+            for (Int32 i = 0; i < names.Length - MaxEntries; i++)
+            {
+                try
+                {
+                    File.Delete(names[i]);
+                }
+                catch (IOException)
+                {
+                    // In use by another instance; it goes next time
+                }
+            }
+        }
+
+        /// <summary>
+        /// Name of the block CRC file for a layout: block count and a CRC of
+        /// the list of sizes tell layouts apart
+        /// </summary>
+        private String BlockCRCFile(String key, UInt32[] blockSizes)
+        {
+            Byte[] sizes = new Byte[blockSizes.Length * 4];
+
+            for (Int32 i = 0; i < blockSizes.Length; i++)
+                BitConverter.GetBytes(blockSizes[i]).CopyTo(sizes, i * 4);
+
+            return Path.Combine(cacheDir, key + "_blocks_" + blockSizes.Length.ToString("X") + "_" +
+                                (new CRC32()).CalculateCRC(sizes).ToString("X8"));
+        }
+
+        #endregion
+    }
+}
@@ -0,0 +1,324 @@
+/****************************************************************
+ *  DVEVM Serial Boot/Flash Host Program - Buffered receive     *
+ ****************************************************************/
+
+using System;
+using System.Text;
+using System.IO.Ports;
+using System.Collections.Generic;
+
+namespace DVFlasher
+{
+    /// <summary>
+    /// Called with the id of each phase marker the UBL sends
+    /// </summary>
+    /// <param name="phase">UART_PHASE_* value from the UBL.</param>
+    public delegate void PhaseHandler(UInt32 phase);
+
+    /// <summary>
+    /// Called with each progress frame the UBL sends during flash work
+    /// </summary>
+    /// <param name="progress">The decoded frame.</param>
+    public delegate void ProgressHandler(FlashProgress progress);
+
+    /// <summary>
+    /// Receive side of the serial link.  Bytes are pulled from the port in
+    /// bulk, as many as the driver has ready, into one reusable buffer, and
+    /// the sequences sent by the ROM and the UBL are matched as the bytes
+    /// go by.  Nothing is allocated per byte or per line.  Phase markers
+    /// ("  PHASE" + 8 hex) and progress frames ("PROGRES" + binary) can
+    /// arrive during any wait and are handed to PhaseReceived and
+    /// ProgressReceived rather than to the caller.
+    /// </summary>
+    public class SerialReader
+    {
+        #region Data members
+
+        private SerialPort port;
+
+        // Receive buffer and the part of it not yet consumed
+        private Byte[] rxBuf;
+        private Int32 rxPos = 0;
+        private Int32 rxLen = 0;
+        private Int64 bytesReceived = 0;
+
+        // Current line, kept only so it can be echoed in verbose mode
+        private Char[] lineBuf = new Char[256];
+        private Int32 lineLen = 0;
+
+        // Compiled sequences, built the first time each one is waited for
+        private Dictionary<String, Sequence> sequences = new Dictionary<String, Sequence>();
+
+        // Looked for alongside every sequence waited for
+        private Sequence phaseSequence = new Sequence("  PHASE\0");
+        private Sequence progressSequence = new Sequence("PROGRES\0");
+        private Byte[] progressFrame = new Byte[FlashProgress.Size];
+
+        #endregion
+
+        #region Sequence matcher
+
+        /// <summary>
+        /// One sequence to look for in the stream, with its KMP failure table so
+        /// that a partial match never needs the stream to be backed up.
+        /// </summary>
+        private class Sequence
+        {
+            public Byte[] pattern;
+            public Int32[] fail;
+            public Int32 state;
+
+            public Sequence(String str)
+            {
+                Int32 k = 0;
+
+                pattern = Encoding.ASCII.GetBytes(str);
+                fail = new Int32[pattern.Length];
+                for (Int32 i = 1; i < pattern.Length; i++)
+                {
+                    while ((k > 0) && (pattern[i] != pattern[k]))
+                        k = fail[k - 1];
+                    if (pattern[i] == pattern[k])
+                        k++;
+                    fail[i] = k;
+                }
+            }
+
+            /// <summary>
+            /// Advance the match by one received byte.
+            /// </summary>
+            /// <returns>True when the whole sequence has just been seen.</returns>
+            public Boolean Step(Byte b)
+            {
+                while ((state > 0) && (b != pattern[state]))
+                    state = fail[state - 1];
+                if (b == pattern[state])
+                    state++;
+                if (state == pattern.Length)
+                {
+                    state = 0;
+                    return true;
+                }
+                return false;
+            }
+        }
+
+        #endregion
+
+        #region Constructors
+
+        /// <summary>
+        /// Buffered reader on an open serial port
+        /// </summary>
+        /// <param name="sp">The serial port to read from.</param>
+        public SerialReader(SerialPort sp)
+        {
+            port = sp;
+            rxBuf = new Byte[Math.Max(sp.ReadBufferSize, 4096)];
+        }
+
+        #endregion
+
+        #region Events
+
+        /// <summary>
+        /// Raised for each phase marker received while waiting for a sequence
+        /// </summary>
+        public event PhaseHandler PhaseReceived;
+
+        /// <summary>
+        /// Raised for each progress frame received while waiting for a sequence
+        /// </summary>
+        public event ProgressHandler ProgressReceived;
+
+        #endregion
+
+        #region Properties
+
+        /// <summary>
+        /// The underlying port, for writing
+        /// </summary>
+        public SerialPort Port
+        {
+            get { return port; }
+        }
+
+        /// <summary>
+        /// Total number of bytes read from the port
+        /// </summary>
+        public Int64 BytesReceived
+        {
+            get { return bytesReceived; }
+        }
+
+        #endregion
+
+        #region Public Methods
+
+        /// <summary>
+        /// Read a single byte
+        /// </summary>
+        public Byte ReadByte()
+        {
+            if (rxPos == rxLen)
+                Fill();
+            return rxBuf[rxPos++];
+        }
+
+        /// <summary>
+        /// Read an exact number of bytes.  Whatever is already buffered is used
+        /// first and the rest is read from the port straight into the caller's array.
+        /// </summary>
+        /// <param name="buffer">Destination array.</param>
+        /// <param name="offset">Where in the array to start.</param>
+        /// <param name="count">Number of bytes to read.</param>
+        public void Read(Byte[] buffer, Int32 offset, Int32 count)
+        {
+            Int32 n = Math.Min(count, rxLen - rxPos);
+
+            Buffer.BlockCopy(rxBuf, rxPos, buffer, offset, n);
+            rxPos += n;
+            offset += n;
+            count -= n;
+
+            while (count > 0)
+            {
+                n = port.Read(buffer, offset, count);
+                bytesReceived += n;
+                offset += n;
+                count -= n;
+            }
+        }
+
+        /// <summary>
+        /// Read a 32-bit value sent as 8 hex characters
+        /// </summary>
+        /// <returns>The value read.</returns>
+        public UInt32 ReadHexWord()
+        {
+            UInt32 value = 0;
+            Byte c;
+
+            for (Int32 i = 0; i < 8; i++)
+            {
+                c = ReadByte();
+                if ((c >= '0') && (c <= '9'))
+                    value = (value << 4) | (UInt32)(c - '0');
+                else if ((c >= 'A') && (c <= 'F'))
+                    value = (value << 4) | (UInt32)(c - 'A' + 10);
+                else if ((c >= 'a') && (c <= 'f'))
+                    value = (value << 4) | (UInt32)(c - 'a' + 10);
+                else
+                    throw new FormatException("Expected a hex digit from the DVEVM, got 0x" + c.ToString("X2") + ".");
+            }
+            return value;
+        }
+
+        /// <summary>
+        /// Consume the stream until one of the given sequences has been received.
+        /// Reading stops right after the last byte of the match, so anything that
+        /// follows it (hex fields, data) is left for the caller.
+        /// </summary>
+        /// <param name="verbose">Echo each received line to the console.</param>
+        /// <param name="strs">The sequences to look for.  If several complete on
+        /// the same byte, the first in the list wins.</param>
+        /// <returns>Index in strs of the sequence that was received.</returns>
+        public Int32 WaitFor(Boolean verbose, params String[] strs)
+        {
+            Sequence[] seqs = new Sequence[strs.Length];
+            Int32 found = -1;
+            UInt32 phase;
+            Byte b;
+
+            for (Int32 i = 0; i < strs.Length; i++)
+            {
+                if (!sequences.TryGetValue(strs[i], out seqs[i]))
+                {
+                    seqs[i] = new Sequence(strs[i]);
+                    sequences.Add(strs[i], seqs[i]);
+                }
+                seqs[i].state = 0;
+            }
+            phaseSequence.state = 0;
+            progressSequence.state = 0;
+
+            while (found < 0)
+            {
+                b = ReadByte();
+
+                // Track the line for echoing; same line breaks as the UBL uses
+                if ((b == 0x00) || (b == 0x0A) || (b == 0x0D) || (lineLen == lineBuf.Length))
+                    EndLine(verbose);
+                if ((b != 0x00) && (b != 0x0A) && (b != 0x0D))
+                    lineBuf[lineLen++] = (Char)b;
+
+                for (Int32 i = seqs.Length - 1; i >= 0; i--)
+                {
+                    if (seqs[i].Step(b))
+                        found = i;
+                }
+
+                if ((found < 0) && phaseSequence.Step(b))
+                {
+                    EndLine(verbose);
+                    phase = ReadHexWord();
+                    if (PhaseReceived != null)
+                        PhaseReceived(phase);
+                }
+
+                // The frame is binary, so it is read here and never matched against
+                if ((found < 0) && progressSequence.Step(b))
+                {
+                    EndLine(verbose);
+                    Read(progressFrame, 0, progressFrame.Length);
+                    if (ProgressReceived != null)
+                        ProgressReceived(new FlashProgress(progressFrame));
+                }
+            }
+            EndLine(verbose);
+
+            return found;
+        }
+
+        /// <summary>
+        /// Drop everything received so far, in the driver and in our buffer
+        /// </summary>
+        public void DiscardInBuffer()
+        {
+            port.DiscardInBuffer();
+            rxPos = 0;
+            rxLen = 0;
+            lineLen = 0;
+        }
+
+        #endregion
+
+        #region Private Methods
+
+        /// <summary>
+        /// Block until at least one byte arrives, then take all that are ready.
+        /// </summary>
+        private void Fill()
+        {
+            rxPos = 0;
+            rxLen = port.Read(rxBuf, 0, rxBuf.Length);
+            bytesReceived += rxLen;
+        }
+
+        /// <summary>
+        /// Finish the current line, echoing it if asked to.
+        /// </summary>
+        private void EndLine(Boolean verbose)
+        {
+            if (verbose && (lineLen > 0))
+            {
+                Console.Write("\tDVEVM:\t");
+                Console.Out.Write(lineBuf, 0, lineLen);
+                Console.WriteLine();
+            }
+            lineLen = 0;
+        }
+
+        #endregion
+    }
+}
@@ -0,0 +1,205 @@
+/****************************************************************
+ *  DVEVM Serial Boot/Flash Host Program - Board session        *
+ ****************************************************************/
+
+using System;
+using System.IO;
+using System.IO.Ports;
+using System.Threading;
+
+namespace DVFlasher
+{
+    /// <summary>
+    /// One board being served on one serial port.  The session carries out
+    /// the command on a thread of its own and signals Done when it is over,
+    /// so callers wait on that (together with anything else) rather than
+    /// polling.  Cancel() closes the port, which fails whatever read or write
+    /// the session is blocked in, and the session unwinds by itself.
+    /// A session can also first wait for a board to announce itself on the
+    /// port, which is how the flashing station uses it.
+    /// </summary>
+    public class Session
+    {
+        #region Data members
+
+        private SerialPort port;
+        private Thread thread;
+        private volatile Boolean cancelled = false;
+        private Boolean succeeded = false;
+        private Boolean waitForBanner = false;
+        private volatile Boolean bannerSeen = false;
+        private DateTime startTime;
+        private DateTime endTime;
+        private ManualResetEvent done = new ManualResetEvent(false);
+
+        #endregion
+
+        #region Constructors
+
+        /// <summary>
+        /// Session on an open serial port
+        /// </summary>
+        /// <param name="sp">The port, which the session closes when it is over.</param>
+        public Session(SerialPort sp)
+        {
+            port = sp;
+        }
+
+        /// <summary>
+        /// Session on an open serial port that can first wait for a board
+        /// </summary>
+        /// <param name="sp">The port, which the session closes when it is over.</param>
+        /// <param name="waitBanner">Wait for " BOOTME" or "BOOTPSP" before starting
+        /// the command, and start it from whichever was seen.</param>
+        public Session(SerialPort sp, Boolean waitBanner)
+        {
+            port = sp;
+            waitForBanner = waitBanner;
+        }
+
+        #endregion
+
+        #region Properties
+
+        public String PortName
+        {
+            get { return port.PortName; }
+        }
+
+        /// <summary>
+        /// Signalled once the session is over
+        /// </summary>
+        public WaitHandle Done
+        {
+            get { return done; }
+        }
+
+        /// <summary>
+        /// Whether the command was carried out (valid once Done is signalled)
+        /// </summary>
+        public Boolean Succeeded
+        {
+            get { return succeeded; }
+        }
+
+        /// <summary>
+        /// Whether a board has been seen on the port (always true for a
+        /// session that does not wait for one)
+        /// </summary>
+        public Boolean BannerSeen
+        {
+            get { return bannerSeen; }
+        }
+
+        /// <summary>
+        /// When the command started, and how long it took (valid once Done is signalled)
+        /// </summary>
+        public DateTime StartTime
+        {
+            get { return startTime; }
+        }
+
+        public TimeSpan Elapsed
+        {
+            get { return endTime - startTime; }
+        }
+
+        #endregion
+
+        #region Public Methods
+
+        /// <summary>
+        /// Start the session's thread
+        /// </summary>
+        public void Start()
+        {
+            thread = new Thread(new ThreadStart(Run));
+            thread.Name = "Session " + port.PortName;
+            thread.IsBackground = true;
+            thread.Start();
+        }
+
+        /// <summary>
+        /// Stop the session wherever it is.  Wait on Done to know it has stopped.
+        /// </summary>
+        public void Cancel()
+        {
+            cancelled = true;
+            try
+            {
+                port.Close();
+            }
+            catch (IOException)
+            {
+            }
+        }
+
+        #endregion
+
+        #region Private Methods
+
+        private void Run()
+        {
+            String banner = null;
+            Telemetry telemetry = null;
+
+            startTime = DateTime.Now;
+            try
+            {
+                Program.MySP = port;
+                Program.MySPReader = new SerialReader(port);
+                if (waitForBanner)
+                {
+                    banner = Program.WaitForBanner();
+                    startTime = DateTime.Now;
+                }
+                bannerSeen = true;
+
+                // Figures start once there is a board to talk to
+                telemetry = new Telemetry(port.PortName, Program.cmdParams.CMDMagicFlag);
+                Program.MyTelemetry = telemetry;
+                Program.MySPReader.PhaseReceived += new PhaseHandler(Program.OnUBLPhase);
+                Program.MySPReader.ProgressReceived += new ProgressHandler(Program.OnFlashProgress);
+                succeeded = Program.RunCommand(banner);
+            }
+            catch (Exception e)
+            {
+                // After a cancel the error is only the closed port, and a port
+                // that goes away before any board shows up is no news either
+                if (!cancelled && bannerSeen)
+                    Console.WriteLine(e.Message);
+            }
+            finally
+            {
+                endTime = DateTime.Now;
+                if (port.IsOpen)
+                    port.Close();
+                if ((telemetry != null) && (Program.cmdParams.TelemetryFile != null))
+                    WriteTelemetry(telemetry);
+                done.Set();
+            }
+        }
+
+        /// <summary>
+        /// Append the session's figures to the telemetry file
+        /// </summary>
+        private void WriteTelemetry(Telemetry telemetry)
+        {
+            try
+            {
+                telemetry.Write(Program.cmdParams.TelemetryFile,
+                                          Program.MySPReader.BytesReceived, succeeded);
+            }
+            catch (IOException e)
+            {
+                Console.WriteLine("WARNING! Could not write to " + Program.cmdParams.TelemetryFile + ": " + e.Message);
+            }
+            catch (UnauthorizedAccessException e)
+            {
+                Console.WriteLine("WARNING! Could not write to " + Program.cmdParams.TelemetryFile + ": " + e.Message);
+            }
+        }
+
+        #endregion
+    }
+}
@@ -0,0 +1,351 @@
+/****************************************************************
+ *  DVEVM Serial Boot/Flash Host Program - S-record encoder     *
+ ****************************************************************/
+
+using System;
+using System.Text;
+using System.IO;
+
+namespace DVFlasher
+{
+    /// <summary>
+    /// Read-only view of a binary stream as Motorola S-records (one S0 record
+    /// naming the module, S3 records of 16 data bytes, one S7 record giving the
+    /// start address).  Records are encoded one at a time as they are read, so
+    /// only a single record is ever held in memory, and since every S3 record
+    /// but the last has the same length the stream can be seeked, which is
+    /// what resuming a transfer needs.
+    /// </summary>
+    public class SrecStream : Stream
+    {
+        #region Data members
+
+        private const Int32 RecordSize = 16;
+
+        // Encoded length of an S3 record: "S3", length, 8 address digits,
+        // data, checksum and line feed
+        private const Int32 FullRecordLen = 15 + (2 * RecordSize);
+
+        private static readonly Byte[] hexDigits = Encoding.ASCII.GetBytes("0123456789ABCDEF");
+
+        private Stream binStream;
+        private Int64 binLength;
+        private UInt32 startAddr;
+
+        private Byte[] header;
+        private Byte[] trailer;
+        private Int64 dataLength;
+        private Int64 position = 0;
+
+        // The S3 record most recently encoded
+        private Byte[] record = new Byte[FullRecordLen];
+        private Byte[] recordData = new Byte[RecordSize];
+        private Int64 recordIndex = -1;
+        private Int32 recordLen = 0;
+
+        #endregion
+
+        #region Constructors
+
+        /// <summary>
+        /// S-record view of a binary image
+        /// </summary>
+        /// <param name="inputStream">The binary data, from its start.</param>
+        /// <param name="loadAddr">The RAM address the data is to be stored at,
+        /// which is also given as the start address.</param>
+        /// <param name="moduleName">Name put in the S0 record (first 20 characters).</param>
+        public SrecStream(Stream inputStream, UInt32 loadAddr, String moduleName)
+        {
+            Byte[] name;
+
+            binStream = inputStream;
+            binLength = inputStream.Length;
+            startAddr = loadAddr;
+
+            // Make sure S-record module name fits in 20 byte field
+            if (moduleName.Length > 20)
+                moduleName = moduleName.Substring(0, 20);
+            name = Encoding.ASCII.GetBytes(moduleName);
+
+            header = new Byte[11 + (2 * name.Length)];
+            EncodeRecord(header, '0', 0x0000, 2, name, name.Length);
+
+            trailer = new Byte[15];
+            EncodeRecord(trailer, '7', startAddr, 4, recordData, 0);
+
+            dataLength = (binLength / RecordSize) * FullRecordLen;
+            if ((binLength % RecordSize) != 0)
+                dataLength += 15 + (2 * (binLength % RecordSize));
+        }
+
+        #endregion
+
+        #region Stream Properties
+
+        public override Boolean CanRead
+        {
+            get { return true; }
+        }
+
+        public override Boolean CanSeek
+        {
+            get { return true; }
+        }
+
+        public override Boolean CanWrite
+        {
+            get { return false; }
+        }
+
+        public override Int64 Length
+        {
+            get { return header.Length + dataLength + trailer.Length; }
+        }
+
+        /// <summary>
+        /// Length of the binary image the records carry
+        /// </summary>
+        public Int64 PayloadLength
+        {
+            get { return binLength; }
+        }
+
+        public override Int64 Position
+        {
+            get { return position; }
+            set
+            {
+                if ((value < 0) || (value > Length))
+                    throw new ArgumentOutOfRangeException("value");
+                position = value;
+            }
+        }
+
+        #endregion
+
+        #region Stream Methods
+
+        /// <summary>
+        /// Read the next bytes of S-record text
+        /// </summary>
+        public override Int32 Read(Byte[] buffer, Int32 offset, Int32 count)
+        {
+            Byte[] src;
+            Int32 srcOffset, srcLen, n, done = 0;
+            Int64 rel;
+
+            while ((done < count) && (position < Length))
+            {
+                rel = position - header.Length;
+                if (rel < 0)
+                {
+                    src = header;
+                    srcOffset = (Int32)position;
+                    srcLen = header.Length;
+                }
+                else if (rel < dataLength)
+                {
+                    LoadRecord(rel / FullRecordLen);
+                    src = record;
+                    srcOffset = (Int32)(rel % FullRecordLen);
+                    srcLen = recordLen;
+                }
+                else
+                {
+                    src = trailer;
+                    srcOffset = (Int32)(rel - dataLength);
+                    srcLen = trailer.Length;
+                }
+
+                n = Math.Min(srcLen - srcOffset, count - done);
+                Buffer.BlockCopy(src, srcOffset, buffer, offset + done, n);
+                position += n;
+                done += n;
+            }
+            return done;
+        }
+
+        public override Int64 Seek(Int64 offset, SeekOrigin origin)
+        {
+            if (origin == SeekOrigin.Current)
+                offset += position;
+            else if (origin == SeekOrigin.End)
+                offset += Length;
+            Position = offset;
+            return position;
+        }
+
+        public override void Flush()
+        {
+        }
+
+        public override void SetLength(Int64 value)
+        {
+            throw new NotSupportedException();
+        }
+
+        public override void Write(Byte[] buffer, Int32 offset, Int32 count)
+        {
+            throw new NotSupportedException();
+        }
+
+        protected override void Dispose(Boolean disposing)
+        {
+            if (disposing)
+                binStream.Close();
+            base.Dispose(disposing);
+        }
+
+        #endregion
+
+        #region Private Methods
+
+        /// <summary>
+        /// Encode the S3 record holding binary bytes from index * 16
+        /// </summary>
+        private void LoadRecord(Int64 index)
+        {
+            Int64 binOffset = index * RecordSize;
+            Int32 len, n;
+
+            if (index == recordIndex)
+                return;
+
+            // Reading in order needs no seek
+            if (binStream.Position != binOffset)
+                binStream.Position = binOffset;
+
+            len = (Int32)Math.Min((Int64)RecordSize, binLength - binOffset);
+            for (Int32 i = 0; i < len; i += n)
+            {
+                n = binStream.Read(recordData, i, len - i);
+                if (n <= 0)
+                    throw new EndOfStreamException("Binary image ended early.");
+            }
+
+            recordLen = EncodeRecord(record, '3', startAddr + (UInt32)binOffset, 4, recordData, len);
+            recordIndex = index;
+        }
+
+        /// <summary>
+        /// Write one S-record, checksum and line feed included
+        /// </summary>
+        /// <returns>Number of bytes written to dst.</returns>
+        private static Int32 EncodeRecord(Byte[] dst, Char type, UInt32 addr, Int32 addrBytes, Byte[] data, Int32 dataLen)
+        {
+            Int32 pos = 0, checksum8, b;
+
+            dst[pos++] = (Byte)'S';
+            dst[pos++] = (Byte)type;
+
+            // Length covers the address, data and checksum bytes
+            checksum8 = addrBytes + dataLen + 1;
+            pos = PutHex(dst, pos, checksum8);
+
+            for (Int32 i = addrBytes - 1; i >= 0; i--)
+            {
+                b = (Int32)((addr >> (8 * i)) & 0xFF);
+                checksum8 += b;
+                pos = PutHex(dst, pos, b);
+            }
+
+            for (Int32 i = 0; i < dataLen; i++)
+            {
+                checksum8 += data[i];
+                pos = PutHex(dst, pos, data[i]);
+            }
+
+            pos = PutHex(dst, pos, (checksum8 & 0xFF) ^ 0xFF);
+            dst[pos++] = 0x0A;
+
+            return pos;
+        }
+
+        private static Int32 PutHex(Byte[] dst, Int32 pos, Int32 b)
+        {
+            dst[pos++] = hexDigits[(b >> 4) & 0xF];
+            dst[pos++] = hexDigits[b & 0xF];
+            return pos;
+        }
+
+        #endregion
+
+        /// <summary>
+        /// Counts the data bytes of S1, S2 and S3 records in S-record text fed
+        /// to it a chunk at a time (e.g. an S-record file as it is sent).  Only
+        /// records whose start is seen are counted.
+        /// </summary>
+        public class RecordCounter
+        {
+            // Looking for 'S' at a line start, then the type and the two
+            // length digits; anything else skips to the next line
+            private const Int32 SeekStart = 0, Type = 1, Count1 = 2, Count2 = 3, SkipLine = 4;
+
+            private Int32 state;
+            private Int32 addrBytes;
+            private Int32 count;
+            private Int64 dataBytes = 0;
+
+            /// <summary>
+            /// Start counting
+            /// </summary>
+            /// <param name="atLineStart">Whether the text starts at the start of
+            /// a line (false when it starts at some offset into a file).</param>
+            public RecordCounter(Boolean atLineStart)
+            {
+                state = atLineStart ? SeekStart : SkipLine;
+            }
+
+            /// <summary>
+            /// Data bytes counted so far
+            /// </summary>
+            public Int64 DataBytes
+            {
+                get { return dataBytes; }
+            }
+
+            /// <summary>
+            /// Count the records in the next chunk of text
+            /// </summary>
+            public void Add(Byte[] text, Int32 len)
+            {
+                Int32 c, digit;
+
+                for (Int32 i = 0; i < len; i++)
+                {
+                    c = text[i];
+                    if ((c == '\n') || (c == '\r'))
+                    {
+                        state = SeekStart;
+                        continue;
+                    }
+
+                    digit = ((c >= '0') && (c <= '9')) ? (c - '0') :
+                            ((c >= 'A') && (c <= 'F')) ? (c - 'A' + 10) :
+                            ((c >= 'a') && (c <= 'f')) ? (c - 'a' + 10) : -1;
+                    switch (state)
+                    {
+                        case SeekStart:
+                            state = (c == 'S') ? Type : SkipLine;
+                            break;
+                        case Type:
+                            addrBytes = c - '0' + 1;
+                            state = ((c >= '1') && (c <= '3')) ? Count1 : SkipLine;
+                            break;
+                        case Count1:
+                            count = digit << 4;
+                            state = (digit >= 0) ? Count2 : SkipLine;
+                            break;
+                        case Count2:
+                            // The length covers the address, data and checksum
+                            count |= digit;
+                            if ((digit >= 0) && (count > addrBytes + 1))
+                                dataBytes += count - addrBytes - 1;
+                            state = SkipLine;
+                            break;
+                    }
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,249 @@
+/****************************************************************
+ *  DVEVM Serial Boot/Flash Host Program - Flashing station     *
+ ****************************************************************/
+
+using System;
+using System.IO;
+using System.IO.Ports;
+using System.Threading;
+using System.Collections.Generic;
+
+namespace DVFlasher
+{
+    /// <summary>
+    /// Flashing station: watch for serial ports coming and going, keep a
+    /// session listening on each, and let every board that shows up (ROM
+    /// " BOOTME" or UBL "BOOTPSP") get the same job.  The outcome for each
+    /// board is appended to a log file.  A board that is done is still in UART
+    /// boot mode and announces itself again, so once a session ends its port
+    /// is only listened on again after it has gone away or has been quiet
+    /// for QuietMs (the board was unplugged or powered off).
+    /// </summary>
+    public class Station
+    {
+        #region Data members
+
+        // How often the list of serial ports is looked at
+        private const Int32 ScanPeriodMs = 1000;
+
+        // Silence that means the board is gone: twice the UBL's 5 s receive
+        // timeout, after which it would have sent "BOOTPSP" again
+        public const Int32 QuietMs = 10000;
+
+        private String portPrefix;
+        private String logFileName;
+        private String job;
+
+        // Port name -> session listening or working on it (null if the port
+        // could not be opened; it is tried again once it has gone away)
+        private Dictionary<String, Session> sessions = new Dictionary<String, Session>();
+
+        // Port name -> port of a board that is done, watched until the board
+        // goes away, and when it was last heard from
+        private Dictionary<String, SerialPort> resting = new Dictionary<String, SerialPort>();
+        private Dictionary<String, Int32> lastHeard = new Dictionary<String, Int32>();
+
+        private Int32 numPassed = 0;
+        private Int32 numFailed = 0;
+
+        #endregion
+
+        #region Constructors
+
+        /// <summary>
+        /// Station for a job
+        /// </summary>
+        /// <param name="prefix">Only ports whose names start with this are used
+        /// (null for all ports).</param>
+        /// <param name="logFile">File the per-board results are appended to.</param>
+        /// <param name="jobText">Description of the job, for the log.</param>
+        public Station(String prefix, String logFile, String jobText)
+        {
+            portPrefix = prefix;
+            logFileName = logFile;
+            job = jobText;
+        }
+
+        #endregion
+
+        #region Public Methods
+
+        /// <summary>
+        /// Serve boards until stop is signalled, then cancel whatever sessions
+        /// are still going.
+        /// </summary>
+        /// <param name="stop">Handle that ends the station.</param>
+        public void Run(WaitHandle stop)
+        {
+            Console.WriteLine("Station mode: waiting for boards on {0}...",
+                              (portPrefix == null) ? "all serial ports" : (portPrefix + "*"));
+
+            do
+            {
+                Scan();
+            } while (!stop.WaitOne(ScanPeriodMs, false));
+
+            Console.WriteLine("Stopping station...");
+            foreach (Session s in sessions.Values)
+            {
+                if (s != null)
+                {
+                    s.Cancel();
+                    s.Done.WaitOne();
+                }
+            }
+            foreach (SerialPort sp in resting.Values)
+                sp.Close();
+            Console.WriteLine("{0} board(s) passed, {1} failed.", numPassed, numFailed);
+        }
+
+        #endregion
+
+        #region Private Methods
+
+        /// <summary>
+        /// Reap finished sessions, forget ports that went away, let go of boards
+        /// that have gone quiet and start listening on new ports
+        /// </summary>
+        private void Scan()
+        {
+            List<String> present = new List<String>();
+            List<String> names = new List<String>(sessions.Keys);
+            Session s;
+
+            foreach (String name in SerialPort.GetPortNames())
+            {
+                if ((portPrefix == null) || name.StartsWith(portPrefix))
+                    present.Add(name);
+            }
+
+            foreach (String name in names)
+            {
+                s = sessions[name];
+                if ((s != null) && s.Done.WaitOne(0, false))
+                {
+                    // A board was seen: log it and wait for it to go away.
+                    // Otherwise the port just went away.
+                    sessions.Remove(name);
+                    if (s.BannerSeen)
+                    {
+                        Log(s);
+                        if (present.Contains(name))
+                            Rest(name);
+                    }
+                }
+                else if ((s == null) && !present.Contains(name))
+                {
+                    sessions.Remove(name);
+                }
+            }
+
+            names = new List<String>(resting.Keys);
+            foreach (String name in names)
+            {
+                if (present.Contains(name) && !Quiet(name))
+                    continue;
+                resting[name].Close();
+                resting.Remove(name);
+                lastHeard.Remove(name);
+            }
+
+            foreach (String name in present)
+            {
+                if (!sessions.ContainsKey(name) && !resting.ContainsKey(name))
+                    Listen(name);
+            }
+        }
+
+        /// <summary>
+        /// Watch the port of a board that is done until the board goes away.
+        /// A port that cannot be watched is only used again once it is gone.
+        /// </summary>
+        private void Rest(String name)
+        {
+            SerialPort sp = Program.OpenPort(name);
+
+            if (sp == null)
+            {
+                sessions[name] = null;
+                return;
+            }
+            Console.WriteLine("Waiting for the board on {0} to be removed.", name);
+            resting[name] = sp;
+            lastHeard[name] = Environment.TickCount;
+        }
+
+        /// <summary>
+        /// Whether the board on a resting port has said nothing for QuietMs
+        /// </summary>
+        private Boolean Quiet(String name)
+        {
+            SerialPort sp = resting[name];
+
+            try
+            {
+                if (sp.BytesToRead > 0)
+                {
+                    sp.DiscardInBuffer();
+                    lastHeard[name] = Environment.TickCount;
+                }
+            }
+            catch (IOException)
+            {
+                // The port went away under us
+                return true;
+            }
+            catch (InvalidOperationException)
+            {
+                return true;
+            }
+            return (Environment.TickCount - lastHeard[name]) >= QuietMs;
+        }
+
+        /// <summary>
+        /// Start a session on a port that waits for a board to announce itself
+        /// </summary>
+        private void Listen(String name)
+        {
+            SerialPort sp = Program.OpenPort(name);
+            Session s = null;
+
+            if (sp != null)
+            {
+                Console.WriteLine("Listening on {0}.", name);
+                s = new Session(sp, true);
+                s.Start();
+            }
+            sessions[name] = s;
+        }
+
+        /// <summary>
+        /// Record the outcome for one board
+        /// </summary>
+        private void Log(Session s)
+        {
+            String line;
+
+            if (s.Succeeded)
+                numPassed++;
+            else
+                numFailed++;
+
+            line = String.Format("{0:yyyy-MM-dd HH:mm:ss}\t{1}\t{2}\t{3:F1} s\t{4}",
+                                 s.StartTime, s.PortName, s.Succeeded ? "PASS" : "FAIL",
+                                 s.Elapsed.TotalSeconds, job);
+            Console.WriteLine("Board on {0}: {1}", s.PortName, s.Succeeded ? "PASS" : "FAIL");
+
+            try
+            {
+                File.AppendAllText(logFileName, line + Environment.NewLine);
+            }
+            catch (IOException e)
+            {
+                Console.WriteLine("WARNING! Could not write to " + logFileName + ": " + e.Message);
+            }
+        }
+
+        #endregion
+    }
+}
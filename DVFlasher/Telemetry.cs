@@ -0,0 +1,264 @@
+/****************************************************************
+ *  DVEVM Serial Boot/Flash Host Program - Session telemetry    *
+ ****************************************************************/
+
+using System;
+using System.Text;
+using System.IO;
+using System.Collections.Generic;
+
+namespace DVFlasher
+{
+    /// <summary>
+    /// Timing and traffic figures of one session, written out as one JSON
+    /// object per line so that line throughput can be tracked over time.
+    /// Phases are marked by the host as protocol steps complete and by the
+    /// UBL's "  PHASE" markers during flash work.  The progress frames of
+    /// each flash phase are summed up into its flash throughput.
+    /// </summary>
+    public class Telemetry
+    {
+        #region Data members
+
+        // Serializes appends from the sessions of a station
+        private static Object fileLock = new Object();
+
+        private String port;
+        private String command;
+        private DateTime start = DateTime.Now;
+        private Int32 startTicks = Environment.TickCount;
+
+        private List<String> phaseNames = new List<String>();
+        private List<Int32> phaseTimes = new List<Int32>();
+
+        private Int64 bytesOut = 0;
+        private Int64 payloadBytes = 0;
+        private Int32 transferMs = 0;
+        private Int32 retries = 0;
+
+        // Flash phase in progress (null if none), its latest progress frame
+        // and the UBL timer ticks summed over its frames
+        private String flashPhase = null;
+        private FlashProgress flashLast = null;
+        private Int64 flashTicks = 0;
+
+        // Summary of each flash phase, as JSON objects
+        private List<String> flashPhases = new List<String>();
+
+        #endregion
+
+        #region Constructors
+
+        /// <summary>
+        /// Start the figures for a session
+        /// </summary>
+        /// <param name="portName">Serial port of the session.</param>
+        /// <param name="cmd">Command being carried out.</param>
+        public Telemetry(String portName, MagicFlags cmd)
+        {
+            port = portName;
+            command = cmd.ToString();
+        }
+
+        #endregion
+
+        #region Public Methods
+
+        /// <summary>
+        /// Note that a phase of the protocol has been reached
+        /// </summary>
+        /// <param name="name">Short name of the phase.</param>
+        public void Mark(String name)
+        {
+            phaseNames.Add(name);
+            phaseTimes.Add(Environment.TickCount - startTicks);
+        }
+
+        /// <summary>
+        /// Note the start of a step that is started over on failure; every
+        /// start after the first counts as a retry
+        /// </summary>
+        /// <param name="name">Short name of the step.</param>
+        public void MarkAttempt(String name)
+        {
+            if (phaseNames.Contains(name))
+                retries++;
+            Mark(name);
+        }
+
+        /// <summary>
+        /// Note a UBL phase marker, which also ends the flash phase before it
+        /// </summary>
+        /// <param name="phase">UART_PHASE_* value sent by the UBL.</param>
+        /// <returns>Throughput report of the flash phase that ended, or null
+        /// if no progress was seen in it.</returns>
+        public String MarkUBLPhase(UInt32 phase)
+        {
+            String report = EndFlashPhase();
+            String name;
+
+            switch (phase)
+            {
+                case 0x1:
+                    name = "burn_ubl";
+                    break;
+                case 0x2:
+                    name = "burn_app";
+                    break;
+                case 0x3:
+                    name = "erase";
+                    break;
+                case 0xF:
+                    name = "burn_end";
+                    break;
+                default:
+                    name = "ubl_phase_" + phase.ToString("X");
+                    break;
+            }
+            Mark(name);
+            flashPhase = (phase == 0xF) ? null : name;
+
+            return report;
+        }
+
+        /// <summary>
+        /// Add a progress frame to the flash phase in progress
+        /// </summary>
+        /// <param name="p">The frame.</param>
+        public void AddFlashProgress(FlashProgress p)
+        {
+            flashTicks += p.Ticks;
+            flashLast = p;
+        }
+
+        /// <summary>
+        /// Seconds of flash work in the current phase, by the UBL's timer
+        /// </summary>
+        public Double FlashSeconds
+        {
+            get { return flashTicks / FlashProgress.TicksPerSecond; }
+        }
+
+        /// <summary>
+        /// Add a bulk transfer to the totals
+        /// </summary>
+        /// <param name="bytes">Bytes written to the port.</param>
+        /// <param name="payload">Bytes of image data they carried, once
+        /// decoded (less than bytes for S-record or hex text).</param>
+        /// <param name="ms">Time the transfer took.</param>
+        public void AddTransfer(Int64 bytes, Int64 payload, Int32 ms)
+        {
+            bytesOut += bytes;
+            payloadBytes += payload;
+            transferMs += ms;
+        }
+
+        /// <summary>
+        /// Append the figures as one JSON line
+        /// </summary>
+        /// <param name="fileName">File to append to.</param>
+        /// <param name="bytesIn">Bytes received over the session.</param>
+        /// <param name="succeeded">Outcome of the session.</param>
+        public void Write(String fileName, Int64 bytesIn, Boolean succeeded)
+        {
+            StringBuilder sb = new StringBuilder(512);
+            Int32 elapsed = Environment.TickCount - startTicks;
+
+            // A session that failed mid-burn still has its phase open
+            EndFlashPhase();
+
+            sb.Append("{");
+            sb.AppendFormat("\"start\":\"{0:yyyy-MM-ddTHH:mm:ss.fff}\",", start);
+            sb.AppendFormat("\"port\":{0},", Quote(port));
+            sb.AppendFormat("\"command\":{0},", Quote(command));
+            sb.AppendFormat("\"result\":\"{0}\",", succeeded ? "pass" : "fail");
+            sb.AppendFormat("\"elapsed_ms\":{0},", elapsed);
+
+            sb.Append("\"phases\":[");
+            for (Int32 i = 0; i < phaseNames.Count; i++)
+            {
+                if (i > 0)
+                    sb.Append(",");
+                sb.AppendFormat("{{\"name\":{0},\"ms\":{1}}}", Quote(phaseNames[i]), phaseTimes[i]);
+            }
+            sb.Append("],");
+
+            sb.Append("\"flash\":[");
+            sb.Append(String.Join(",", flashPhases.ToArray()));
+            sb.Append("],");
+
+            sb.AppendFormat("\"bytes_out\":{0},", bytesOut);
+            sb.AppendFormat("\"payload_bytes\":{0},", payloadBytes);
+            sb.AppendFormat("\"bytes_in\":{0},", bytesIn);
+            sb.AppendFormat("\"transfer_ms\":{0},", transferMs);
+            // 10 bits a character on the line (8N1)
+            sb.AppendFormat("\"effective_baud\":{0},", (transferMs > 0) ? ((bytesOut * 10000) / transferMs) : 0);
+            sb.AppendFormat("\"retries\":{0}", retries);
+            sb.Append("}");
+
+            lock (fileLock)
+            {
+                File.AppendAllText(fileName, sb.ToString() + "\n");
+            }
+        }
+
+        #endregion
+
+        #region Private Methods
+
+        /// <summary>
+        /// Close the flash phase in progress, keeping its summary
+        /// </summary>
+        /// <returns>Report of the phase, or null if it saw no progress.</returns>
+        private String EndFlashPhase()
+        {
+            String report = null;
+            Double seconds = FlashSeconds;
+            Double rate;
+
+            if ((flashPhase != null) && (flashLast != null))
+            {
+                rate = (seconds > 0.0) ? (flashLast.BytesWritten / seconds) : 0.0;
+                flashPhases.Add(String.Format(
+                    "{{\"phase\":{0},\"bytes\":{1},\"ms\":{2},\"blocks_erased\":{3}," +
+                    "\"pages\":{4},\"ecc_fixes\":{5},\"retries\":{6}}}",
+                    Quote(flashPhase), flashLast.BytesWritten, (Int64)(seconds * 1000.0),
+                    flashLast.BlocksErased, flashLast.PagesWritten, flashLast.ECCFixes, flashLast.Retries));
+
+                report = String.Format(
+                    "{0}: 0x{1:X8} bytes in {2:F1} s ({3:F1} kB/s), {4} block(s) erased, {5} page(s), " +
+                    "{6} ECC correction(s), {7} retry(ies)",
+                    flashPhase, flashLast.BytesWritten, seconds, rate / 1024.0,
+                    flashLast.BlocksErased, flashLast.PagesWritten, flashLast.ECCFixes, flashLast.Retries);
+            }
+
+            flashPhase = null;
+            flashLast = null;
+            flashTicks = 0;
+            return report;
+        }
+
+        /// <summary>
+        /// JSON string literal of s
+        /// </summary>
+        private static String Quote(String s)
+        {
+            StringBuilder sb = new StringBuilder(s.Length + 2);
+
+            sb.Append('"');
+            foreach (Char c in s)
+            {
+                if ((c == '"') || (c == '\\'))
+                    sb.Append('\\').Append(c);
+                else if (c < ' ')
+                    sb.AppendFormat("\\u{0:x4}", (Int32)c);
+                else
+                    sb.Append(c);
+            }
+            sb.Append('"');
+            return sb.ToString();
+        }
+
+        #endregion
+    }
+}
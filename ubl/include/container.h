@@ -0,0 +1,75 @@
+/* --------------------------------------------------------------------------
+    FILE        : container.h
+    PURPOSE     : Multi-segment boot container header file
+    PROJECT     : DaVinci User Boot-Loader and Flasher
+ ----------------------------------------------------------------------------- */
+
+#ifndef _CONTAINER_H_
+#define _CONTAINER_H_
+
+#include "tistdtypes.h"
+
+/* A container is stored or downloaded like an S-record or ELF image:
+ *
+ *   CONTAINER_HDR
+ *   CONTAINER_SEG[numSegments]
+ *   segment data and kernel command line, at the offsets given above
+ *
+ * Every segment is copied to its load address and checked there against
+ * its CRC-32. With CONTAINER_FLAG_LINUX set, an ATAG list is built and the
+ * entry point is called the way a Linux kernel expects (r1 = machine
+ * type, r2 = ATAG list).
+ */
+
+/************* Constants and Macros **************/
+#define CONTAINER_MAGIC         (0x434C4255)    // "UBLC"
+
+// Header flags
+#define CONTAINER_FLAG_LINUX    (0x00000001)    // Boot the entry point as a Linux kernel
+
+// Segment types
+#define CONTAINER_SEG_DATA      (0)             // Plain data, just loaded
+#define CONTAINER_SEG_KERNEL    (1)             // Kernel image
+#define CONTAINER_SEG_INITRD    (2)             // Initial ramdisk, passed in ATAG_INITRD2
+
+// Segment compression
+#define CONTAINER_COMP_NONE     (0)
+
+// Default location of the ATAG list
+#define CONTAINER_ATAG_ADDR     (RAM_START_ADDR + 0x100)
+
+// Longest kernel command line passed on
+#define CONTAINER_CMDLINE_MAX   (1024)
+
+// ATAG identifiers
+#define ATAG_NONE               (0x00000000)
+#define ATAG_CORE               (0x54410001)
+#define ATAG_MEM                (0x54410002)
+#define ATAG_INITRD2            (0x54420005)
+#define ATAG_CMDLINE            (0x54410009)
+
+typedef struct _CONTAINER_HDR_ {
+   Uint32       magicNum;                   // CONTAINER_MAGIC
+   Uint32       numSegments;                // Entries in the segment table after this header
+   Uint32       entryPoint;                 // Where execution starts once all segments are loaded
+   Uint32       flags;                      // CONTAINER_FLAG_* values
+   Uint32       machType;                   // ARM Linux machine type (CONTAINER_FLAG_LINUX)
+   Uint32       atagAddress;                // Where to build the ATAG list (0 = CONTAINER_ATAG_ADDR)
+   Uint32       memSize;                    // DDR size given to the kernel (0 = whole RAM window)
+   Uint32       cmdlineOffset;              // Offset of the NUL terminated command line (0 = none)
+} CONTAINER_HDR, *PCONTAINER_HDR;
+
+typedef struct _CONTAINER_SEG_ {
+   Uint32       type;                       // CONTAINER_SEG_* value
+   Uint32       offset;                     // Offset of the data from the start of the container
+   Uint32       size;                       // Number of data bytes
+   Uint32       ldAddress;                  // Where the data is loaded
+   Uint32       compression;                // CONTAINER_COMP_* value
+   Uint32       crc;                        // CRC-32 of the data as stored
+} CONTAINER_SEG, *PCONTAINER_SEG;
+
+/*************************** Function Prototypes *************************/
+Bool CONTAINER_IsImage(Uint8 *imageAddr);
+Uint32 CONTAINER_Load(Uint8 *imageAddr, Uint32 imageByteCnt, Uint32 *entryPoint, Uint32 *loadByteCnt);
+
+#endif //_CONTAINER_H_
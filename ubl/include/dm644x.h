@@ -357,6 +357,7 @@ typedef struct _timer_regs_
 } timerRegs;
 
 #define TIMER0 ((timerRegs*) 0x01C21400)
+#define TIMER1 ((timerRegs*) 0x01C21800)
 
 //Timer inline functions
 static inline void TIMER0Start(void)
@@ -373,6 +374,48 @@ static inline int TIMER0Status(void)
      return ((AINTC->IRQ1)&1);
 }
 
+/* -------------------------------------------------------------------------- *
+ *    Clock and DDR2 timing profile                                           *
+ * -------------------------------------------------------------------------- */
+#define CLK_DM6446      0
+#define CLK_DM6441      1
+#define CLK_DM6441_LV   2
+
+typedef struct _CLOCK_PROFILE_
+{
+    const char *name;       // "DSP/DDR" clocks in MHz (ARM runs at DSP/2)
+    Uint8  device;          // CLK_DM644x part the profile is validated for
+    Uint8  pll1Mult;        // DSP/ARM PLL multiplier
+    Uint8  pll2Mult;        // DDR PLL multiplier and dividers
+    Uint8  pll2Div1;
+    Uint8  pll2Div2;
+    Uint8  nm;              // SDBCR fields
+    Uint8  cl;
+    Uint8  ibank;
+    Uint8  pageSize;
+    Uint8  tRFC;            // SDTIMR fields
+    Uint8  tRP;
+    Uint8  tRCD;
+    Uint8  tWR;
+    Uint8  tRAS;
+    Uint8  tRC;
+    Uint8  tRRD;
+    Uint8  tWTR;
+    Uint8  tXSNR;           // SDTIMR2 fields
+    Uint8  tXSRD;
+    Uint8  tRTP;
+    Uint8  tCKE;
+    Uint16 refreshRate;     // SDRCR
+    Uint8  boardDelay;
+    Uint8  readLatency;     // DDRPHYCR
+} CLOCK_PROFILE;
+
+extern const CLOCK_PROFILE gClockProfiles[];
+extern const CLOCK_PROFILE *gClockProfile;
+
+// The AEMIF is clocked from PLL1 SYSCLK4, the DSP clock / 6
+#define AEMIF_CLK_DIV   6
+
 // Function Prototypes
 
 // Execute LPSC state transition
@@ -380,12 +423,14 @@ void LPSCTransition(Uint8 module, Uint8 state);
 
 // Initialization prototypes
 void DM644xInit(void);
+void SelectClockProfile(void);
 void PSCInit(void);
 void UARTInit(void);
 void PLL1Init(void);
 void PLL2Init(void);
 void DDR2Init(void);
 //void AEMIFInit(void);
+void AEMIFSetReadTimings(Uint32 setupNs, Uint32 accessNs, Uint32 oeNs);
 void IVTInit(void);
 
 // NOP wait loop 
@@ -0,0 +1,54 @@
+/* --------------------------------------------------------------------------
+    FILE        : elf.h
+    PURPOSE     : ELF32 image loader header file
+    PROJECT     : DaVinci User Boot-Loader and Flasher
+ ----------------------------------------------------------------------------- */
+
+#ifndef _ELF_H_
+#define _ELF_H_
+
+#include "tistdtypes.h"
+
+/************* Constants and Macros **************/
+#define ELF_MAGIC           (0x464C457F)    // 0x7F 'E' 'L' 'F' read as a little endian word
+#define ELF_CLASS32         (1)             // e_ident[EI_CLASS]
+#define ELF_DATA2LSB        (2)             // e_ident[EI_DATA]
+#define ELF_ET_EXEC         (2)             // e_type for an executable
+#define ELF_EM_ARM          (40)            // e_machine for ARM
+#define ELF_PT_LOAD         (1)             // p_type of a loadable segment
+
+// ELF32 file header
+typedef struct _ELF32_EHDR_ {
+    Uint8       e_ident[16];
+    Uint16      e_type;
+    Uint16      e_machine;
+    Uint32      e_version;
+    Uint32      e_entry;
+    Uint32      e_phoff;
+    Uint32      e_shoff;
+    Uint32      e_flags;
+    Uint16      e_ehsize;
+    Uint16      e_phentsize;
+    Uint16      e_phnum;
+    Uint16      e_shentsize;
+    Uint16      e_shnum;
+    Uint16      e_shstrndx;
+} ELF32_EHDR, *PELF32_EHDR;
+
+// ELF32 program header
+typedef struct _ELF32_PHDR_ {
+    Uint32      p_type;
+    Uint32      p_offset;
+    Uint32      p_vaddr;
+    Uint32      p_paddr;
+    Uint32      p_filesz;
+    Uint32      p_memsz;
+    Uint32      p_flags;
+    Uint32      p_align;
+} ELF32_PHDR, *PELF32_PHDR;
+
+/*************************** Function Prototypes *************************/
+Bool ELF_IsImage(Uint8 *imageAddr);
+Uint32 ELF_Load(Uint8 *imageAddr, Uint32 imageByteCnt, Uint32 *entryPoint, Uint32 *loadByteCnt);
+
+#endif //_ELF_H_
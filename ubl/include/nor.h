@@ -41,6 +41,9 @@
 #define AMD_PROG_CMD                0xA0        // AMD simple Write command
 #define AMD_WRT_BUF_LOAD_CMD        0x25        // AMD write buffer load command
 #define AMD_WRT_BUF_CONF_CMD        0x29        // AMD write buffer confirm command
+#define AMD_UNLOCK_BYPASS_CMD       0x20        // AMD unlock bypass enter command
+#define AMD_UNLOCK_BYPASS_RST_CMD0  0x90        // AMD unlock bypass reset (exit) first cycle
+#define AMD_UNLOCK_BYPASS_RST_CMD1  0x00        // AMD unlock bypass reset (exit) second cycle
 
 /**************** DEFINES for Intel Basic Command Set **************/
 #define INTEL_ID_CMD            0x90        // Intel ID CMD
@@ -140,8 +143,32 @@ typedef struct _NOR_MEDIA_STRUCT_ {
    MANFID       manfID;                             // Manufacturer's ID
    Uint16       devID1;                             // Device ID
    Uint16       devID2;                             // Used for AMD 3-byte ID devices
+   Bool         unlockBypass;                       // AMD unlock bypass mode is active
 } NOR_INFO, *PNOR_INFO;
 
+// Per-block state flags kept in the block map
+#define NOR_BLK_ERASED          0x01        // Block erased (and not written since) this session
+#define NOR_BLK_UNLOCKED        0x02        // Block lock bit known to be clear
+
+// Most blocks handed to the flash in one queued erase (keeps status output flowing)
+#define NOR_ERASE_BATCH         16
+
+// Read timings (ns) for NOR_SetReadTimings: address setup, address to data
+// and OE to data.  CFI does not report these, so they come from the part's
+// datasheet; the defaults suit 110 ns parts, with 10 ns to spare.
+#define NOR_READ_SETUP_NS       30
+#define NOR_READ_ACCESS_NS      120
+#define NOR_READ_OE_NS          35
+
+// Erase block map built once by NOR_Init() from the CFI region data
+typedef struct _NOR_BLOCK_MAP_ {
+   Uint32       numBlocks;                          // Total number of erase blocks in the flash
+   Uint32       regionAddr[CFI_MAXREGIONS+1];       // Start address of each region (last entry is end of flash)
+   Uint32       regionBlock[CFI_MAXREGIONS+1];      // Number of the first block in each region
+   Uint8        blockShift[CFI_MAXREGIONS];         // log2 of the block size in each region
+   Uint8        *blockState;                        // NOR_BLK_* flags for every block
+} NOR_BLOCK_MAP, *PNOR_BLOCK_MAP;
+
 typedef union {
 	Uint8 c;
 	Uint16 w;
@@ -163,8 +190,15 @@ Uint32 NOR_Copy(void);
 Uint32 NOR_WriteBytes(Uint32 writeAddress, Uint32 numBytes, Uint32 readAddress);
 Uint32 NOR_GlobalErase();
 Uint32 NOR_Erase(Uint32 start_address, Uint32 size);
+void NOR_SetReadTimings(void);
 Uint32 DiscoverBlockInfo(Uint32 address,Uint32* blockSize, Uint32* blockAddr);
 
+// Block map construction and lookups
+Uint32 NOR_BuildBlockMap(void);
+Uint32 NOR_AddrToBlock(Uint32 address, Uint32* blockNum);
+Uint32 NOR_BlockAddr(Uint32 blockNum);
+Uint32 NOR_BlockSize(Uint32 blockNum);
+
 // Flash Identification  and Discovery
 Uint32 QueryCFI( Uint32 baseAddress );
 
@@ -184,23 +218,27 @@ Bool flash_issetsome (Uint32 blkAddr, Uint32 offset, Uint8 mask);
 // Generic commands that will point to either AMD or Intel command set
 Uint32 (* Flash_Write)(Uint32, VUint32);
 Uint32 (* Flash_BufferWrite)( Uint32, VUint8[], Uint32);
-Uint32 (* Flash_Erase)(Uint32);
+Uint32 (* Flash_EraseStart)(Uint32, Uint32, Uint32*);
+Uint32 (* Flash_EraseWait)(Uint32, Uint32);
 Uint32 (* Flash_ID)(Uint32);
 
 // Empty commands for when neither command set is used
-Uint32 Unsupported_Erase( Uint32 );
+Uint32 Unsupported_EraseStart( Uint32, Uint32, Uint32* );
+Uint32 Unsupported_EraseWait( Uint32, Uint32 );
 Uint32 Unsupported_Write( Uint32, VUint32 );
 Uint32 Unsupported_BufferWrite( Uint32, VUint8[], Uint32 );
 Uint32 Unsupported_ID( Uint32 );
 
 //Intel pointer-mapped commands
-Uint32 Intel_Erase( VUint32 blkAddr);
+Uint32 Intel_EraseStart( Uint32 blockNum, Uint32 endBlockNum, Uint32* lastBlock );
+Uint32 Intel_EraseWait( Uint32 blockNum, Uint32 lastBlock );
 Uint32 Intel_Write( Uint32 address, VUint32 data );
 Uint32 Intel_BufferWrite( Uint32 address, VUint8 data[], Uint32 numBytes );
 Uint32 Intel_ID( Uint32 );
 
 //AMD pointer-mapped commands
-Uint32 AMD_Erase(Uint32 blkAddr);
+Uint32 AMD_EraseStart( Uint32 blockNum, Uint32 endBlockNum, Uint32* lastBlock );
+Uint32 AMD_EraseWait( Uint32 blockNum, Uint32 lastBlock );
 Uint32 AMD_Write( Uint32 address, VUint32 data );
 Uint32 AMD_BufferWrite(Uint32 address, VUint8 data[], Uint32 numBytes );
 Uint32 AMD_ID( Uint32 );
@@ -217,5 +255,7 @@ void Intel_Wait_For_Status_Complete();
 void AMD_Soft_Reset_Flash();
 void AMD_Prefix_Commands();
 void AMD_Write_Buf_Abort_Reset_Flash();
+void AMD_Unlock_Bypass_Enter();
+void AMD_Unlock_Bypass_Exit();
 
 #endif //_NOR_H_
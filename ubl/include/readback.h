@@ -0,0 +1,27 @@
+/* --------------------------------------------------------------------------
+    FILE        : readback.h
+    PURPOSE     : Flash readback commands header file
+    PROJECT     : DaVinci User Boot-Loader and Flasher
+ ----------------------------------------------------------------------------- */
+
+#ifndef _READBACK_H_
+#define _READBACK_H_
+
+#include "tistdtypes.h"
+
+/************* Constants and Macros **************/
+#define READBACK_MAX_PAGES      (64)            // Pages per block in the readback protocol
+#define READBACK_MAP_WORDS      (READBACK_MAX_PAGES / 32)
+
+// Range flags sent by the host
+#define READBACK_FLAG_COMPRESS  (0x0001)        // Leave erased pages out of a dump
+
+// Per block status sent to the host
+#define READBACK_BLK_OK         (0)
+#define READBACK_BLK_READ_ERR   (1)             // Uncorrectable ECC error in the block
+
+/*************************** Function Prototypes *************************/
+Uint32 READBACK_Dump(void);
+Uint32 READBACK_Verify(void);
+
+#endif //_READBACK_H_
@@ -0,0 +1,38 @@
+/* --------------------------------------------------------------------------
+    FILE        : session.h
+    PURPOSE     : Resumable UART transfer session header file
+    PROJECT     : DaVinci User Boot-Loader and Flasher
+ ----------------------------------------------------------------------------- */
+
+#ifndef _SESSION_H_
+#define _SESSION_H_
+
+#include "tistdtypes.h"
+#include "uart.h"
+
+/************* Constants and Macros **************/
+#define SESSION_MAGIC       (0x53534255)    // "UBSS" read as a little endian word
+#define SESSION_BLOCK_SIZE  (0x00010000)    // Unit in which receive progress is recorded
+
+// The record lives just past the DMA region, which ubl_mem_init() never hands
+// out, so it survives the arena reset when UART_Boot() starts over
+#define SESSION_ADDR        (RAM_START_ADDR + MAX_IMAGE_SIZE + DMA_MEM_SIZE)
+
+// Progress of the data transfer described by one ACK header
+typedef struct _UBL_SESSION_ {
+    Uint32      magicNum;       // SESSION_MAGIC while the record is in use
+    Uint32      imageMagic;     // ACK header fields the record belongs to
+    Uint32      appStartAddr;
+    Uint32      srecByteCnt;
+    Uint32      srecAddr;       // Receive buffer (must come out the same again)
+    Uint32      bytesDone;      // Received so far, a whole number of blocks
+    Uint32      dataCrc;        // CRC32 of the first bytesDone bytes
+    Uint32      recordCrc;      // CRC32 of the fields above
+} UBL_SESSION;
+
+/*************************** Function Prototypes *************************/
+Uint32 SESSION_Negotiate(UART_ACK_HEADER *ackHeader, Uint32 *offset);
+Uint32 SESSION_RecvData(UART_ACK_HEADER *ackHeader, Uint32 offset);
+void SESSION_End(void);
+
+#endif //_SESSION_H_
@@ -23,15 +23,63 @@ typedef struct _UART_ACK_HEADER{
     Uint32      srecAddr;
     Uint32      binByteCnt;
     Uint32      binAddr;
+    Uint32      flags;
 } UART_ACK_HEADER;
 
+// ACK header flags (the last four hex characters of the header)
+#define UART_FLAG_RESUME    (0x0001)    // Host can resume an interrupted transfer
+#define UART_FLAG_SEGMENTED (0x8000)    // Set by the UBL: ELF or container data
+
+// Binary command frame, sent by the host after BOOTPSP as "  FRAME" + null
+// and the structure as raw little-endian bytes (instead of "    CMD" + hex).
+// It carries the headers of the images the command needs, in the order the
+// UBL asks for them, so no SENDUBL/SENDAPP + ACK round trip is needed.
+#define UART_FRAME_MAX_HEADERS  (2)
+
+typedef struct _UART_FRAME_HEADER{
+    Uint32      magicNum;
+    Uint32      appStartAddr;
+    Uint32      byteCnt;
+    Uint32      flags;
+} UART_FRAME_HEADER;
+
+typedef struct _UART_CMD_FRAME{
+    Uint32              bootCmd;
+    Uint32              numHeaders;
+    UART_FRAME_HEADER   header[UART_FRAME_MAX_HEADERS];
+    Uint32              crc;        // CRC32 of the fields above
+} UART_CMD_FRAME;
+
+// Phase markers ("  PHASE" + 8 hex) sent while the host waits on a command
+#define UART_PHASE_BURN_UBL (0x00000001)    // Erasing/writing the flash UBL
+#define UART_PHASE_BURN_APP (0x00000002)    // Erasing/writing the application
+#define UART_PHASE_ERASE    (0x00000003)    // Global erase
+#define UART_PHASE_END      (0x0000000F)    // Flash work finished
+
+// Progress frame ("PROGRES" + null + the structure as raw little-endian
+// bytes) sent during flash work. Counts run from the last phase marker.
+typedef struct _UART_PROGRESS{
+    Uint32      bytesWritten;   // Bytes programmed
+    Uint32      bytesTotal;     // Bytes to program, as far as known yet
+    Uint16      blocksErased;
+    Uint16      pagesWritten;   // NAND pages programmed (0 for NOR)
+    Uint16      eccFixes;       // Bit errors corrected by ECC on verify
+    Uint16      retries;        // Blocks skipped or writes redone
+    Uint32      ticks;          // TIMER1 ticks since the previous frame
+} UART_PROGRESS;
+
+extern UART_PROGRESS gProgress;
+
 // ------ Function prototypes ------ 
 // Main boot function 
 void UART_Boot(void);
 
 // Simple send/recv functions
 Uint32 UARTSendData(Uint8* seq, Bool includeNull);
+Uint32 UARTSendBytes(Uint8* seq, Uint32 numBytes);
 Uint32 UARTSendInt(Uint32 value);
+Uint32 UARTSendPhase(Uint32 phase);
+Uint32 UARTSendProgress(void);
 Int32 GetStringLen(Uint8* seq);
 Uint32 UARTRecvData(Uint32 numBytes, Uint8* seq);
 
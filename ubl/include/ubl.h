@@ -41,7 +41,8 @@
 #define UBL_MAGIC_DMA_IC_FAST		(0xA1ACED55)		/* DMA + ICache + Fast EMIF boot mode */
 
 /* Used by UBL when doing UART boot, UBL Nor Boot, or NAND boot */
-#define UBL_MAGIC_BIN_IMG			(0xA1ACED66)		/* Execute in place supported*/
+#define UBL_MAGIC_BIN_IMG			(0xA1ACED66)		/* Binary image, copied to its load address */
+#define UBL_MAGIC_XIP_IMG			(0xA1ACEDEE)		/* Binary image, executed in place from NOR */
 
 /* Used by UBL when doing UART boot */
 #define UBL_MAGIC_NOR_RESTORE		(0xA1ACED77)		/* Download via UART & Restore NOR with binary data */
@@ -51,6 +52,8 @@
 #define UBL_MAGIC_NAND_SREC_BURN	(0xA1ACEDBB)		/* Download via UART & Burn NAND - Image is S-record*/
 #define UBL_MAGIC_NAND_BIN_BURN		(0xA1ACEDCC)		/* Download via UART & Burn NAND - Image is binary */
 #define UBL_MAGIC_NAND_GLOBAL_ERASE	(0xA1ACEDDD)		/* Download via UART & Global erase the NAND Flash*/
+#define UBL_MAGIC_DUMP				(0xA1ACED10)		/* Read a block range of the flash back via UART */
+#define UBL_MAGIC_VERIFY			(0xA1ACED20)		/* Check a block range of the flash against CRCs sent via UART */
 
 // Define UBL image size
 #define UBL_IMAGE_SIZE      (0x00003800)
@@ -58,10 +61,18 @@
 // Define maximum downloadable image size
 #define MAX_IMAGE_SIZE		(0x00800000)
 
+// Define the DMA-able buffer region that follows the scratch region in DDR
+#define DMA_MEM_SIZE		(0x00100000)
+#define DMA_MEM_ALIGN		(32)				/* ARM926 cache line size */
+
 /* Set details of RAM */
 #define RAM_START_ADDR		(0x80000000)
 #define RAM_END_ADDR		(0x8FFFFFFF)
 
+/* Set details of the CS2 NOR window (execute-in-place images run here) */
+#define NOR_START_ADDR		(0x02000000)
+#define NOR_END_ADDR		(0x03FFFFFF)
+
 typedef struct {
 	Uint32 magicNum;	/* Expected magic number */
 	Uint32 entryPoint;	/* Entry point of the user application */
@@ -108,6 +119,6 @@ void boot( void ) __attribute__((naked,section (".boot")));
 void selfcopy( void ) __attribute__((naked,section (".selfcopy")));
 
 Int32 main(void);
-void (*APPEntry)(void);
+void (*APPEntry)(Uint32, Uint32, Uint32);
 
 #endif //_UBL_H_
@@ -15,15 +15,42 @@
 
 #define ENDIAN_SWAP(a) (((a&0xFF)<<24)|((a&0xFF0000)>>8)|((a&0xFF00)<<8)|((a&0xFF000000)>>24))
 
+// Position of both DDR allocation regions, for nested mark/release scopes
+typedef struct _UBL_MEM_MARK_ {
+	Uint32 scratch;
+	Uint32 dma;
+} UBL_MEM_MARK;
+
 // Memory Allocation for decoing the s-record
+void ubl_mem_init(void);
 void *ubl_alloc_mem (Uint32 size);
-Uint32 get_current_mem_loc(void);
-void set_current_mem_loc(Uint32 value);
+void *ubl_alloc_dma_mem (Uint32 size);
+void ubl_mem_mark(UBL_MEM_MARK *mark);
+void ubl_mem_release(UBL_MEM_MARK *mark);
+
+// Checks for images loaded segment by segment (ELF and containers)
+Bool ubl_load_target_ok(Uint32 addr, Uint32 numBytes);
+Uint32 ubl_stage_image(Uint8 **imageAddr, Uint32 imageByteCnt, Uint32 loadStart, Uint32 loadEnd);
 
 // Routines to decode the S-record
-Uint32 GetHexData(Uint8 *src, Uint32 numBytes, Uint8* seq);
-Uint32 GetHexAddr(Uint8 *src, Uint32* addr);
+#define HEX_INVALID		0xFF
+#define HEX_TABLE_SIZE		('f' - '0' + 1)
+extern const Uint8 gHexTable[HEX_TABLE_SIZE];
+Uint32 HexToWord(Uint8 *src, Uint32 numChars, Uint32 *value);
+Uint32 HexToBytes(Uint8 *src, Uint32 numBytes, Uint8 *dest, Uint32 *checksum);
+Uint32 GetHexData(Uint8 *src, Uint32 numBytes, Uint8* seq, Uint32 *checksum);
+Uint32 GetHexAddr(Uint8 *src, Uint32* addr, Uint32 *checksum);
 Uint32 SRecDecode(Uint8 *srecAddr, Uint32 srecByteCnt, Uint32 *binAddr, Uint32 *binByteCnt);
+Uint32 CRC32Calc(Uint32 crc, Uint8 *data, Uint32 numBytes);
+Uint32 ImageDecode(Uint8 *imageAddr, Uint32 imageByteCnt, Uint32 *binAddr, Uint32 *binByteCnt);
+
+// Word copy using 8-register load/store multiples
+void BurstCopy(Uint32 *dest, Uint32 *src, Uint32 numWords);
+
+// Alignment-aware memory primitives
+void *ubl_memcpy(void *dest, const void *src, Uint32 numBytes);
+void *ubl_memset(void *dest, Uint8 value, Uint32 numBytes);
+Int32 ubl_memcmp(const void *buf1, const void *buf2, Uint32 numBytes);
 
 // NOP wait loop 
 void waitloop(unsigned int loopcnt);
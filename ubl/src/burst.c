@@ -0,0 +1,84 @@
+/* --------------------------------------------------------------------------
+    FILE        : burst.c
+    PURPOSE     : LDM/STM burst copy and fill
+    PROJECT     : DaVinci User Boot-Loader and Flasher
+ ----------------------------------------------------------------------------- */
+
+// The rest of the UBL is Thumb code; these loops use LDM/STM of r3-r10,
+// which only ARM code has, so this file is built as ARM (see makefile).
+
+#include "ubl.h"
+#include "util.h"
+
+// Copy words with LDM/STM of eight registers at a time, so a large copy
+// (e.g. from NOR) is limited by the bus rather than by loop overhead
+void BurstCopy(Uint32 *dest, Uint32 *src, Uint32 numWords)
+{
+	while (numWords >= 8)
+	{
+		asm volatile (
+			" LDMIA	%0!, {r3-r10}\n"
+			" STMIA	%1!, {r3-r10}"
+			: "+r" (src), "+r" (dest)
+			:
+			: "r3", "r4", "r5", "r6", "r7", "r8", "r9", "r10", "memory" );
+		numWords -= 8;
+	}
+	
+	// Remaining words
+	while (numWords--)
+		*dest++ = *src++;
+}
+
+// Fill memory, a 32-byte cache line per STM once the pointer is aligned
+void *ubl_memset(void *dest, Uint8 value, Uint32 numBytes)
+{
+	Uint8 *d = (Uint8 *) dest;
+	Uint32 *w;
+	Uint32 pattern;
+
+	while ( (((Uint32) d & 0x3) != 0) && (numBytes != 0) )
+	{
+		*d++ = value;
+		numBytes--;
+	}
+
+	pattern = value | (value << 8);
+	pattern |= (pattern << 16);
+	w = (Uint32 *) d;
+
+	// Load the pattern into r3-r10 once, then store it until fewer than
+	// 32 bytes remain
+	if (numBytes >= 32)
+	{
+		asm volatile (
+			" MOV	r3, %2\n"
+			" MOV	r4, %2\n"
+			" MOV	r5, %2\n"
+			" MOV	r6, %2\n"
+			" MOV	r7, %2\n"
+			" MOV	r8, %2\n"
+			" MOV	r9, %2\n"
+			" MOV	r10, %2\n"
+			" SUB	%1, %1, #32\n"
+			"1:\n"
+			" STMIA	%0!, {r3-r10}\n"
+			" SUBS	%1, %1, #32\n"
+			" BGE	1b\n"
+			" ADD	%1, %1, #32"
+			: "+r" (w), "+r" (numBytes)
+			: "r" (pattern)
+			: "r3", "r4", "r5", "r6", "r7", "r8", "r9", "r10", "cc", "memory" );
+	}
+	while (numBytes >= 4)
+	{
+		*w++ = pattern;
+		numBytes -= 4;
+	}
+
+	d = (Uint8 *) w;
+	while (numBytes--)
+		*d++ = value;
+
+	return dest;
+}
@@ -0,0 +1,223 @@
+/* --------------------------------------------------------------------------
+    FILE        : container.c
+    PURPOSE     : Multi-segment boot container loader
+    PROJECT     : DaVinci User Boot-Loader and Flasher
+ ----------------------------------------------------------------------------- */
+
+#ifdef UBL_CONTAINER
+
+#include "ubl.h"
+#include "dm644x.h"
+#include "uart.h"
+#include "util.h"
+#include "container.h"
+
+extern Uint32 gMachType;
+extern Uint32 gAtagAddr;
+
+// Most bytes CONTAINER_BuildAtags() can write
+#define CONTAINER_ATAG_MAX      (CONTAINER_CMDLINE_MAX + 64)
+
+// Check for the container magic number at the start of an image
+Bool CONTAINER_IsImage(Uint8 *imageAddr)
+{
+    return ( ((Uint32) imageAddr & 0x3) == 0 ) && ( *((Uint32 *) imageAddr) == CONTAINER_MAGIC );
+}
+
+// Build the kernel ATAG list in the DMA arena, which no segment may load
+// into, then move it into place (the destination may overlap the container
+// the command line came from)
+static Uint32 CONTAINER_BuildAtags(CONTAINER_HDR *hdr, Uint8 *imageAddr, Uint32 imageByteCnt,
+                                   Uint32 initrdAddr, Uint32 initrdSize)
+{
+    Uint32 *atags, *tag, *dest, numWords, i;
+    Uint8  *cmdline = 0, *str;
+    Uint32 cmdlineLen = 0;
+    UBL_MEM_MARK mark;
+
+    if (hdr->cmdlineOffset != 0)
+    {
+        cmdline = imageAddr + hdr->cmdlineOffset;
+        while ( ((hdr->cmdlineOffset + cmdlineLen) < imageByteCnt) &&
+                (cmdline[cmdlineLen] != 0) && (cmdlineLen < CONTAINER_CMDLINE_MAX) )
+            cmdlineLen++;
+    }
+
+    ubl_mem_mark(&mark);
+    atags = (Uint32 *) ubl_alloc_dma_mem(CONTAINER_ATAG_MAX);
+    if (atags == 0)
+        return E_FAIL;
+    tag = atags;
+
+    // ATAG_CORE with no root device
+    *tag++ = 5; *tag++ = ATAG_CORE;
+    *tag++ = 0; *tag++ = 4096; *tag++ = 0;
+
+    // ATAG_MEM for the DDR
+    *tag++ = 4; *tag++ = ATAG_MEM;
+    *tag++ = (hdr->memSize) ? hdr->memSize : (RAM_END_ADDR - RAM_START_ADDR + 1);
+    *tag++ = RAM_START_ADDR;
+
+    if (initrdSize != 0)
+    {
+        *tag++ = 4; *tag++ = ATAG_INITRD2;
+        *tag++ = initrdAddr; *tag++ = initrdSize;
+    }
+
+    if (cmdlineLen != 0)
+    {
+        *tag++ = 2 + ((cmdlineLen + 4) >> 2); *tag++ = ATAG_CMDLINE;
+        str = (Uint8 *) tag;
+        ubl_memcpy(str, cmdline, cmdlineLen);
+        ubl_memset(str + cmdlineLen, 0, ((((cmdlineLen + 4) >> 2) << 2) - cmdlineLen));
+        tag += ((cmdlineLen + 4) >> 2);
+    }
+
+    *tag++ = 0; *tag++ = ATAG_NONE;
+
+    // Move the list into place (checked by CONTAINER_Load), copying
+    // downwards when it moves up
+    dest = (Uint32 *) gAtagAddr;
+    numWords = tag - atags;
+    if (dest < atags)
+        for (i = 0; i < numWords; i++)
+            dest[i] = atags[i];
+    else
+        for (i = numWords; i > 0; i--)
+            dest[i - 1] = atags[i - 1];
+
+    ubl_mem_release(&mark);
+    gMachType = hdr->machType;
+    return E_PASS;
+}
+
+// Check and scatter-load every segment of a container
+Uint32 CONTAINER_Load(Uint8 *imageAddr, Uint32 imageByteCnt, Uint32 *entryPoint, Uint32 *loadByteCnt)
+{
+    CONTAINER_HDR *hdr = (CONTAINER_HDR *) imageAddr;
+    CONTAINER_SEG *seg;
+    CONTAINER_SEG *prev;
+    Uint8  *src, *dest;
+    Uint32 i, initrdAddr = 0, initrdSize = 0;
+    Uint32 loadStart = 0xFFFFFFFF, loadEnd = 0;
+
+    // Sizes are compared by subtraction, so no sum can wrap past the checks.
+    // The table size is multiplied out (Thumb code has no divide) once the
+    // segment count is small enough that the product cannot wrap either.
+    if ( (imageByteCnt < sizeof(CONTAINER_HDR)) ||
+         (hdr->numSegments > imageByteCnt) ||
+         ((hdr->numSegments * sizeof(CONTAINER_SEG)) > (imageByteCnt - sizeof(CONTAINER_HDR))) )
+    {
+        UARTSendData((Uint8 *) "Container segment table is invalid.\r\n", FALSE);
+        return E_FAIL;
+    }
+
+    // Check every segment before anything is copied; the data itself is
+    // only checked once it is in place
+    seg = (CONTAINER_SEG *) (imageAddr + sizeof(CONTAINER_HDR));
+    for (i = 0; i < hdr->numSegments; i++, seg++)
+    {
+        if ( (seg->offset > imageByteCnt) || (seg->size > (imageByteCnt - seg->offset)) ||
+             (seg->compression != CONTAINER_COMP_NONE) )
+        {
+            UARTSendData((Uint8 *) "Container segment is invalid or compressed.\r\n", FALSE);
+            return E_FAIL;
+        }
+
+        if (!ubl_load_target_ok(seg->ldAddress, seg->size))
+        {
+            UARTSendData((Uint8 *) "Container segment overlaps UBL memory at 0x", FALSE);
+            UARTSendInt(seg->ldAddress);
+            UARTSendData((Uint8 *) "\r\n", FALSE);
+            return E_FAIL;
+        }
+
+        if (seg->size == 0)
+            continue;
+
+        // No segment may load on top of another
+        for (prev = (CONTAINER_SEG *) (imageAddr + sizeof(CONTAINER_HDR)); prev < seg; prev++)
+        {
+            if ( (prev->size != 0) &&
+                 (seg->ldAddress < (prev->ldAddress + prev->size)) &&
+                 (prev->ldAddress < (seg->ldAddress + seg->size)) )
+            {
+                UARTSendData((Uint8 *) "Container segments overlap at 0x", FALSE);
+                UARTSendInt(seg->ldAddress);
+                UARTSendData((Uint8 *) "\r\n", FALSE);
+                return E_FAIL;
+            }
+        }
+
+        if (seg->ldAddress < loadStart)
+            loadStart = seg->ldAddress;
+        if ((seg->ldAddress + seg->size) > loadEnd)
+            loadEnd = seg->ldAddress + seg->size;
+    }
+
+    // The ATAG list is written after the segments are checked, so it may
+    // not land on one of them or on UBL memory
+    if (hdr->flags & CONTAINER_FLAG_LINUX)
+    {
+        gAtagAddr = (hdr->atagAddress) ? hdr->atagAddress : CONTAINER_ATAG_ADDR;
+        if ( !ubl_load_target_ok(gAtagAddr, CONTAINER_ATAG_MAX) ||
+             ( (loadStart < loadEnd) && (gAtagAddr < loadEnd) &&
+               (loadStart < (gAtagAddr + CONTAINER_ATAG_MAX)) ) )
+        {
+            UARTSendData((Uint8 *) "Container ATAG address is invalid: 0x", FALSE);
+            UARTSendInt(gAtagAddr);
+            UARTSendData((Uint8 *) "\r\n", FALSE);
+            return E_FAIL;
+        }
+    }
+
+    // A kernel linked at the start of DDR lands on the receive buffer
+    if (ubl_stage_image(&imageAddr, imageByteCnt, loadStart, loadEnd) != E_PASS)
+    {
+        UARTSendData((Uint8 *) "No room to move the container clear of its segments.\r\n", FALSE);
+        return E_FAIL;
+    }
+    hdr = (CONTAINER_HDR *) imageAddr;
+
+    seg = (CONTAINER_SEG *) (imageAddr + sizeof(CONTAINER_HDR));
+    for (i = 0; i < hdr->numSegments; i++, seg++)
+    {
+        src  = imageAddr + seg->offset;
+        dest = (Uint8 *) seg->ldAddress;
+        ubl_memcpy(dest, src, seg->size);
+    }
+
+    // Check the segments where they ended up, so a bad download or bad
+    // memory is caught before anything is run
+    *loadByteCnt = 0;
+    seg = (CONTAINER_SEG *) (imageAddr + sizeof(CONTAINER_HDR));
+    for (i = 0; i < hdr->numSegments; i++, seg++)
+    {
+        if (CRC32Calc(0, (Uint8 *) seg->ldAddress, seg->size) != seg->crc)
+        {
+            UARTSendData((Uint8 *) "Container segment CRC failure at 0x", FALSE);
+            UARTSendInt(seg->ldAddress);
+            UARTSendData((Uint8 *) "\r\n", FALSE);
+            return E_FAIL;
+        }
+
+        if (seg->type == CONTAINER_SEG_INITRD)
+        {
+            initrdAddr = seg->ldAddress;
+            initrdSize = seg->size;
+        }
+        *loadByteCnt += seg->size;
+    }
+
+    if ( (hdr->flags & CONTAINER_FLAG_LINUX) &&
+         (CONTAINER_BuildAtags(hdr, imageAddr, imageByteCnt, initrdAddr, initrdSize) != E_PASS) )
+    {
+        UARTSendData((Uint8 *) "Could not build kernel ATAGs.\r\n", FALSE);
+        return E_FAIL;
+    }
+
+    *entryPoint = hdr->entryPoint;
+    return E_PASS;
+}
+
+#endif
@@ -16,6 +16,10 @@
 	          Fix for DDRPHYCR misread from user's guide.
          v1.14 - DJA - 13-Sep-2007
                Fix for DSP power domain initialzation - reflects U-boot fix
+         v1.15 - PLL and DDR settings moved into a table of clock profiles
+               chosen at build time or by device
+         v1.16 - Optional RTS/CTS autoflow control on UART0 (FLOW=rtscts)
+         v1.17 - TIMER1 left free-running to time flash work
  ----------------------------------------------------------------------------- */
 
 #include "dm644x.h"
@@ -27,100 +31,70 @@ extern BootMode gBootMode;
 extern Uint32 gEntryPoint;
 
 // ---------------------------------------------------------------------------
-// Global Memory Timing and PLL Settings
+// Clock and DDR timing profiles
+//   Each entry is a validated DSP/DDR clock pair (the ARM runs at half the
+//   DSP clock) with the matching timings for the Micron MT47H64M16BT-37E.
+//   Entries for a device are ordered from slowest to fastest, and
+//   SelectClockProfile() takes the last one for the device the UBL was
+//   built for.
 // ---------------------------------------------------------------------------
+const CLOCK_PROFILE gClockProfiles[] =
+{
+    // name       device         PLL1 PLL2 M/D1/D2  NM CL IB PS  RFC RP RCD WR RAS RC  RRD WTR XSNR XSRD RTP CKE  RR    BD RL
+    { "405/135",  CLK_DM6441_LV, 15,  20, 10, 2,    0, 3, 3, 2,  17,  2, 2,  2, 5,  7,  1,  1,  18,  199, 1,  2,   1264, 3, 5 },
+    { "513/162",  CLK_DM6441,    19,  24, 12, 2,    0, 3, 3, 2,  20,  2, 2,  2, 6,  8,  2,  1,  22,  199, 1,  2,   1053, 3, 5 },
+    // 567 version - only use this with older silicon/EVMs (CLOCK_PROFILE=2)
+    { "567/189",  CLK_DM6446,    21,  14, 7,  1,    0, 4, 3, 2,  24,  2, 2,  2, 7,  10, 2,  1,  25,  199, 1,  2,   1477, 2, 5 },
+    { "594/162",  CLK_DM6446,    22,  24, 12, 2,    0, 3, 3, 2,  20,  2, 2,  2, 6,  8,  2,  1,  22,  199, 1,  2,   1053, 3, 5 }
+};
+
+#define NUM_CLOCK_PROFILES  (sizeof(gClockProfiles) / sizeof(CLOCK_PROFILE))
+
+// Device of each gClockProfiles entry, for checking UBL_CLOCK_PROFILE at build
+// time (keep in step with the table)
+#define CLOCK_PROFILE_DEVICE(i) \
+    (((i) == 0) ? CLK_DM6441_LV : (((i) == 1) ? CLK_DM6441 : CLK_DM6446))
+
+// Device the UBL was built for
 #if defined(DM6441_LV)
-    // For Micron MT47H64M16BT-37E @ 135 MHz   
-    const Uint8 DDR_NM = 0;
-    const Uint8 DDR_CL = 3;
-    const Uint8 DDR_IBANK = 3;
-    const Uint8 DDR_PAGESIZE = 2;
-    const Uint8 DDR_T_RFC = 17;
-    const Uint8 DDR_T_RP = 2;
-    const Uint8 DDR_T_RCD = 2;
-    const Uint8 DDR_T_WR = 2;
-    const Uint8 DDR_T_RAS = 5;
-    const Uint8 DDR_T_RC = 7;
-    const Uint8 DDR_T_RRD = 1;
-    const Uint8 DDR_T_WTR = 1;
-    const Uint8 DDR_T_XSNR = 18;
-    const Uint8 DDR_T_XSRD = 199;
-    const Uint8 DDR_T_RTP = 1;
-    const Uint8 DDR_T_CKE = 2;
-    const Uint16 DDR_RR = 1264;
-    const Uint8 DDR_Board_Delay = 3;
-    const Uint8 DDR_READ_Latency = 5;
-    
-    const Uint32 PLL2_Mult = 20;
-    const Uint32 PLL2_Div1 = 10;
-    const Uint32 PLL2_Div2 = 2;
+    #define CLOCK_DEVICE    CLK_DM6441_LV
+#elif defined(DM6441)
+    #define CLOCK_DEVICE    CLK_DM6441
 #else
-    // For Micron MT47H64M16BT-37E @ 162 MHz
-    const Uint8 DDR_NM = 0;
-    const Uint8 DDR_CL = 3;
-    const Uint8 DDR_IBANK = 3;
-    const Uint8 DDR_PAGESIZE = 2;
-    const Uint8 DDR_T_RFC = 20;
-    const Uint8 DDR_T_RP = 2;
-    const Uint8 DDR_T_RCD = 2;
-    const Uint8 DDR_T_WR = 2;
-    const Uint8 DDR_T_RAS = 6;
-    const Uint8 DDR_T_RC = 8;
-    const Uint8 DDR_T_RRD = 2;
-    const Uint8 DDR_T_WTR = 1;
-    const Uint8 DDR_T_XSNR = 22;
-    const Uint8 DDR_T_XSRD = 199;
-    const Uint8 DDR_T_RTP = 1;
-    const Uint8 DDR_T_CKE = 2;
-    const Uint16 DDR_RR = 1053;
-    const Uint8 DDR_Board_Delay = 3;
-    const Uint8 DDR_READ_Latency = 5; 
-    
-    const Uint32 PLL2_Mult = 24;
-    const Uint32 PLL2_Div1 = 12;
-    const Uint32 PLL2_Div2 = 2;
-    
-    // 567 verison - only use this with older silicon/EVMs
-    // For Micron MT47H64M16BT-37E @ 189 MHz
-    /*const Uint8 DDR_NM = 0;
-    const Uint8 DDR_CL = 4;
-    const Uint8 DDR_IBANK = 3;
-    const Uint8 DDR_PAGESIZE = 2;
-    const Uint8 DDR_T_RFC = 24;
-    const Uint8 DDR_T_RP = 2;
-    const Uint8 DDR_T_RCD = 2;
-    const Uint8 DDR_T_WR = 2;
-    const Uint8 DDR_T_RAS = 7;
-    const Uint8 DDR_T_RC = 10;
-    const Uint8 DDR_T_RRD = 2;
-    const Uint8 DDR_T_WTR = 1;
-    const Uint8 DDR_T_XSNR = 25;
-    const Uint8 DDR_T_XSRD = 199;
-    const Uint8 DDR_T_RTP = 1;
-    const Uint8 DDR_T_CKE = 2;
-    const Uint16 DDR_RR = 1477;
-    const Uint8 DDR_Board_Delay = 2;
-    const Uint8 DDR_READ_Latency = 5;
-    
-    const Uint32 PLL2_Mult = 14;
-    const Uint32 PLL2_Div1 = 7;
-    const Uint32 PLL2_Div2 = 1;*/
+    #define CLOCK_DEVICE    CLK_DM6446
 #endif
 
-// Set CPU clocks
-#if defined(DM6441_LV)
-    const Uint32 PLL1_Mult = 15;  // DSP=405 MHz
-#elif defined(DM6441)
-    const Uint32 PLL1_Mult = 19;  // DSP=513 MHz  
-#else
-    const Uint32 PLL1_Mult = 22;  // DSP=594 MHz
-    // 567 version - only use this with older silicon/EVMs
-    // Uint32 PLL1_Mult = 21;
+// Profile in use, set by SelectClockProfile()
+const CLOCK_PROFILE *gClockProfile;
+
+#if defined(UBL_CLOCK_PROFILE)
+// Fails to compile unless UBL_CLOCK_PROFILE is an entry for the device built for
+typedef char clockProfileCheck[ ( ((UBL_CLOCK_PROFILE) >= 0) &&
+                                  ((UBL_CLOCK_PROFILE) < NUM_CLOCK_PROFILES) &&
+                                  (CLOCK_PROFILE_DEVICE(UBL_CLOCK_PROFILE) == CLOCK_DEVICE) ) ? 1 : -1 ];
 #endif
     
 // ---------------------------------------------------------
 // End of global PLL and Memory settings
 // ---------------------------------------------------------
+
+// Choose the clock profile.  A UBL_CLOCK_PROFILE index given at build time
+// wins; otherwise take the fastest profile for this device.
+void SelectClockProfile(void)
+{
+#if defined(UBL_CLOCK_PROFILE)
+    gClockProfile = &gClockProfiles[UBL_CLOCK_PROFILE];
+#else
+    Uint32 i;
+    
+    gClockProfile = &gClockProfiles[0];
+    for (i = 0; i < NUM_CLOCK_PROFILES; i++)
+    {
+        if (gClockProfiles[i].device == CLOCK_DEVICE)
+            gClockProfile = &gClockProfiles[i];
+    }
+#endif
+}
     
 
 void LPSCTransition(Uint8 module, Uint8 state)
@@ -158,6 +132,7 @@ void DM644xInit()
 	UARTInit();
 	
 	/******************* System PLL Setup ********************/
+	SelectClockProfile();
 	PLL1Init();
 	
 	/******************* DDR PLL Setup ***********************/	
@@ -301,7 +276,7 @@ void PLL2Init()
 	PLL2->PLLCTL &= (~0x00000021);
 
 	// Wait for PLLEN mux to switch 
-	waitloop(32*(PLL1_Mult/2));
+	waitloop(32*(gClockProfile->pll1Mult/2));
 	
 	PLL2->PLLCTL &= (~0x00000008);          // Put PLL into reset
 	PLL2->PLLCTL |= (0x00000010);           // Disable the PLL
@@ -309,18 +284,18 @@ void PLL2Init()
 	PLL2->PLLCTL &= (~0x00000010);          // Enable the PLL
 	
 	// Set PLL multipliers and divisors 
-	PLL2->PLLM      = PLL2_Mult-1;     // 27  Mhz * (23+1) = 648 MHz 
-	PLL2->PLLDIV1   = PLL2_Div1-1;     // 648 MHz / (11+1) = 54  MHz
-	PLL2->PLLDIV2   = PLL2_Div2-1;     // 648 MHz / (1+1 ) = 324 MHz (the PHY DDR rate)
+	PLL2->PLLM      = gClockProfile->pll2Mult-1;     // 27  Mhz * (23+1) = 648 MHz 
+	PLL2->PLLDIV1   = gClockProfile->pll2Div1-1;     // 648 MHz / (11+1) = 54  MHz
+	PLL2->PLLDIV2   = gClockProfile->pll2Div2-1;     // 648 MHz / (1+1 ) = 324 MHz (the PHY DDR rate)
 		
 	PLL2->PLLDIV2 |= (0x00008000);          // Enable DDR divider	
 	PLL2->PLLDIV1 |= (0x00008000);          // Enable VPBE divider	
 	PLL2->PLLCMD |= 0x00000001;             // Tell PLL to do phase alignment
 	while ((PLL2->PLLSTAT) & 0x1);          // Wait until done
-	waitloop(256*(PLL1_Mult/2));
+	waitloop(256*(gClockProfile->pll1Mult/2));
 
 	PLL2->PLLCTL |= (0x00000008);           // Take PLL out of reset	
-	waitloop(2000*(PLL1_Mult/2));                       // Wait for locking
+	waitloop(2000*(gClockProfile->pll1Mult/2));                       // Wait for locking
 	
 	PLL2->PLLCTL |= (0x00000001);           // Switch out of bypass mode
 }
@@ -328,44 +303,44 @@ void PLL2Init()
 void DDR2Init()
 {
 	Int32 tempVTP;
+	const CLOCK_PROFILE *clk = gClockProfile;
 	
 	// Set the DDR2 to enable
 	LPSCTransition(LPSC_DDR2, PSC_ENABLE);
 		
-	// For Micron MT47H64M16BT-37E @ 162 MHz
 	// Setup the read latency (CAS Latency + 3 = 6 (but write 6-1=5))
-	DDR->DDRPHYCR = (0x50006400) | DDR_READ_Latency;
+	DDR->DDRPHYCR = (0x50006400) | clk->readLatency;
 	// Set TIMUNLOCK bit, CAS LAtency 3, 8 banks, 1024-word page size 
 	//DDR->SDBCR = 0x00138632;
 	DDR->SDBCR = 0x00138000 |
-	             (DDR_NM << 14)   |
-	             (DDR_CL << 9)    |
-	             (DDR_IBANK << 4) |
-	             (DDR_PAGESIZE <<0);
+	             (clk->nm << 14)    |
+	             (clk->cl << 9)     |
+	             (clk->ibank << 4)  |
+	             (clk->pageSize <<0);
 	
 	// Program timing registers 
 	//DDR->SDTIMR = 0x28923211;
-	DDR->SDTIMR = (DDR_T_RFC << 25) |              
-                  (DDR_T_RP << 22)  |
-                  (DDR_T_RCD << 19) |
-                  (DDR_T_WR << 16)  |
-                  (DDR_T_RAS << 11) |
-                  (DDR_T_RC << 6)   |
-                  (DDR_T_RRD << 3)  |
-                  (DDR_T_WTR << 0);
+	DDR->SDTIMR = (clk->tRFC << 25) |              
+                  (clk->tRP << 22)  |
+                  (clk->tRCD << 19) |
+                  (clk->tWR << 16)  |
+                  (clk->tRAS << 11) |
+                  (clk->tRC << 6)   |
+                  (clk->tRRD << 3)  |
+                  (clk->tWTR << 0);
                   
 	//DDR->SDTIMR2 = 0x0016C722;
-	DDR->SDTIMR2 = (DDR_T_XSNR << 16) |
-                   (DDR_T_XSRD << 8)  |
-                   (DDR_T_RTP << 5)   |
-                   (DDR_T_CKE << 0);
+	DDR->SDTIMR2 = (clk->tXSNR << 16) |
+                   (clk->tXSRD << 8)  |
+                   (clk->tRTP << 5)   |
+                   (clk->tCKE << 0);
     
     
     // Clear the TIMUNLOCK bit 
 	DDR->SDBCR &= (~0x00008000);
 	
 	// Set the refresh rate
-	DDR->SDRCR = DDR_RR;
+	DDR->SDRCR = clk->refreshRate;
 	
 	// Dummy write/read to apply timing settings
 	DDRMem[0] = DDR_TEST_PATTERN;
@@ -400,12 +375,6 @@ void DDR2Init()
 
 void PLL1Init()
 {
-    //594 version
-    //Uint32 PLL1_Mult = 22;
-        
-    //567 version - use with 189 MHZ DDR
-    //Uint32 PLL1_Mult = 21;
-            
 	// Set PLL2 clock input to internal osc. 
 	PLL1->PLLCTL &= (~0x00000100);	
 	
@@ -421,7 +390,7 @@ void PLL1Init()
 	PLL1->PLLCTL &= (~0x00000010);     // Enable the PLL
 	
 	// Set PLL multipliers and divisors 
-	PLL1->PLLM = PLL1_Mult - 1;        // 27Mhz * (21+1) = 594 MHz 
+	PLL1->PLLM = gClockProfile->pll1Mult - 1;        // 27Mhz * (21+1) = 594 MHz 
 			
 	PLL1->PLLCMD |= 0x00000001;		// Tell PLL to do phase alignment
 	while ((PLL1->PLLSTAT) & 0x1);	// Wait until done
@@ -442,6 +411,47 @@ void AEMIFInit()
    AEMIF->AB4CR     = 0x3FFFFFFD;
    AEMIF->NANDFCR   = 0x00000000;
 }*/
+
+// AEMIF cycles (at clk10, the AEMIF clock in 100 kHz units) covering ns,
+// between 1 and max.  Counted up rather than divided, as Thumb code has no
+// divide and the UBL is linked without libgcc.
+static Uint32 AEMIFCycles(Uint32 ns, Uint32 clk10, Uint32 max)
+{
+    Uint32 cycles = 1;
+
+    while (((cycles * 10000) < (ns * clk10)) && (cycles < max))
+        cycles++;
+    return cycles;
+}
+
+// Set the CS2 read timings for a part with the given address setup, access
+// (address to data) and output enable times in ns, at the AEMIF clock of the
+// clock profile in use.  The AB1CR fields hold cycles - 1.  Write timings
+// stay at the maximum.
+void AEMIFSetReadTimings(Uint32 setupNs, Uint32 accessNs, Uint32 oeNs)
+{
+    Uint32 clk10 = (270 / AEMIF_CLK_DIV) * gClockProfile->pll1Mult;
+    Uint32 setup, strobe, access;
+
+    // Data must be valid accessNs after the address and oeNs after OE,
+    // which is asserted for the strobe period
+    setup  = AEMIFCycles(setupNs, clk10, 16);
+    strobe = AEMIFCycles(oeNs, clk10, 64);
+    access = AEMIFCycles(accessNs, clk10, 80);
+    if ((setup + strobe) < access)
+        strobe = access - setup;
+    if (strobe > 64)
+        strobe = 64;
+
+    AEMIF->AB1CR = ( AEMIF->AB1CR & 0x3 )       // asyncSize unchanged
+        | ( 0xF << 26 )                         // writeSetup  = 16 cycles
+        | ( 0x3F<< 20 )                         // writeStrobe = 64 cycles
+        | ( 7 << 17 )                           // writeHold   = 8 cycles
+        | ( (setup - 1) << 13 )                 // readSetup
+        | ( (strobe - 1) << 7 )                 // readStrobe
+        | ( 0 << 4 )                            // readHold    = 1 cycle
+        | ( 3 << 2 );                           // turnAround  = 4 cycles
+}
  
 void UARTInit()
 {		
@@ -455,11 +465,21 @@ void UARTInit()
 	UART0->DLL = 0x0F;
 	UART0->DLH = 0x00; 
 
+#ifdef UBL_UART_RTSCTS
+    // Enable, clear and reset FIFOs, receive trigger level at 8 bytes so
+    // RTS drops while the FIFO still has room for bytes already in flight
+	UART0->FCR = 0x87;
+
+	// Enable autoflow control: RTS follows the receive FIFO and the
+	// transmitter waits for CTS (board must route UART0 CTS/RTS)
+	UART0->MCR = 0x22;
+#else
     // Enable, clear and reset FIFOs	
 	UART0->FCR = 0x07;
 	
 	// Disable autoflow control 
 	UART0->MCR = 0x00;
+#endif
 	
 	// Enable receiver, transmitter, st to run. 
 	UART0->PWREMU_MGNT |= 0x6001;
@@ -480,6 +500,15 @@ void UARTInit()
 	// Set timer period (5 second timeout = (27000000 * 5) cycles = 0x080BEFC0) 
 	TIMER0->PRD34 = 0x00000000;
 	TIMER0->PRD12 = 0x080BEFC0;
+
+	// TIMER1 free-runs at 27 MHz (dual 32-bit unchained, continuous) to time
+	// flash work for the progress frames
+	TIMER1->TCR = 0x00000000;
+	TIMER1->TGCR = 0x00000000;
+	TIMER1->TIM12 = 0x00000000;
+	TIMER1->PRD12 = 0xFFFFFFFF;
+	TIMER1->TGCR = 0x00000007;
+	TIMER1->TCR = 0x00000080;
 }
 
 void IVTInit()
@@ -0,0 +1,111 @@
+/* --------------------------------------------------------------------------
+    FILE        : elf.c
+    PURPOSE     : ELF32 image loader
+    PROJECT     : DaVinci User Boot-Loader and Flasher
+ ----------------------------------------------------------------------------- */
+
+#ifdef UBL_ELF
+
+#include "ubl.h"
+#include "dm644x.h"
+#include "uart.h"
+#include "util.h"
+#include "elf.h"
+
+// Check for the ELF magic number at the start of an image
+Bool ELF_IsImage(Uint8 *imageAddr)
+{
+    return ( ((Uint32) imageAddr & 0x3) == 0 ) && ( *((Uint32 *) imageAddr) == ELF_MAGIC );
+}
+
+// Load every PT_LOAD segment of an ELF32 executable to its physical address,
+// zero filling the part of each segment not present in the file (.bss)
+Uint32 ELF_Load(Uint8 *imageAddr, Uint32 imageByteCnt, Uint32 *entryPoint, Uint32 *loadByteCnt)
+{
+    ELF32_EHDR *ehdr = (ELF32_EHDR *) imageAddr;
+    ELF32_PHDR *phdr;
+    Uint8      *src, *dest;
+    Uint32     i, loadStart = 0xFFFFFFFF, loadEnd = 0;
+
+    // Only little endian 32-bit ARM executables can be run here
+    if ( (imageByteCnt < sizeof(ELF32_EHDR)) ||
+         (ehdr->e_ident[4] != ELF_CLASS32) ||
+         (ehdr->e_ident[5] != ELF_DATA2LSB) ||
+         (ehdr->e_type != ELF_ET_EXEC) ||
+         (ehdr->e_machine != ELF_EM_ARM) )
+    {
+        UARTSendData((Uint8 *) "ELF image is not an ARM executable.\r\n", FALSE);
+        return E_FAIL;
+    }
+
+    // The program header table must be inside the image and word aligned
+    // (sizes are compared by subtraction, so no sum can wrap past the checks)
+    if ( (ehdr->e_phentsize != sizeof(ELF32_PHDR)) ||
+         (ehdr->e_phoff & 0x3) ||
+         (ehdr->e_phoff > imageByteCnt) ||
+         (ehdr->e_phnum > ((imageByteCnt - ehdr->e_phoff) / sizeof(ELF32_PHDR))) )
+    {
+        UARTSendData((Uint8 *) "ELF program headers are invalid.\r\n", FALSE);
+        return E_FAIL;
+    }
+
+    // Check every segment before anything is copied
+    phdr = (ELF32_PHDR *) (imageAddr + ehdr->e_phoff);
+    for (i = 0; i < ehdr->e_phnum; i++, phdr++)
+    {
+        if ( (phdr->p_type != ELF_PT_LOAD) || (phdr->p_memsz == 0) )
+            continue;
+
+        if ( (phdr->p_offset > imageByteCnt) || (phdr->p_filesz > (imageByteCnt - phdr->p_offset)) ||
+             (phdr->p_filesz > phdr->p_memsz) )
+        {
+            UARTSendData((Uint8 *) "ELF segment is outside the image.\r\n", FALSE);
+            return E_FAIL;
+        }
+
+        if (!ubl_load_target_ok(phdr->p_paddr, phdr->p_memsz))
+        {
+            UARTSendData((Uint8 *) "ELF segment overlaps UBL memory at 0x", FALSE);
+            UARTSendInt(phdr->p_paddr);
+            UARTSendData((Uint8 *) "\r\n", FALSE);
+            return E_FAIL;
+        }
+
+        if (phdr->p_paddr < loadStart)
+            loadStart = phdr->p_paddr;
+        if ((phdr->p_paddr + phdr->p_memsz) > loadEnd)
+            loadEnd = phdr->p_paddr + phdr->p_memsz;
+    }
+
+    // An image linked at the start of DDR lands on the receive buffer
+    if (ubl_stage_image(&imageAddr, imageByteCnt, loadStart, loadEnd) != E_PASS)
+    {
+        UARTSendData((Uint8 *) "No room to move the ELF image clear of its segments.\r\n", FALSE);
+        return E_FAIL;
+    }
+    ehdr = (ELF32_EHDR *) imageAddr;
+
+    *loadByteCnt = 0;
+    phdr = (ELF32_PHDR *) (imageAddr + ehdr->e_phoff);
+    for (i = 0; i < ehdr->e_phnum; i++, phdr++)
+    {
+        if ( (phdr->p_type != ELF_PT_LOAD) || (phdr->p_memsz == 0) )
+            continue;
+
+        src  = imageAddr + phdr->p_offset;
+        dest = (Uint8 *) phdr->p_paddr;
+
+        // Copy the file contents of the segment
+        ubl_memcpy(dest, src, phdr->p_filesz);
+
+        // Zero the rest of the segment
+        ubl_memset(dest + phdr->p_filesz, 0, (phdr->p_memsz - phdr->p_filesz));
+
+        *loadByteCnt += phdr->p_memsz;
+    }
+
+    *entryPoint = ehdr->e_entry;
+    return E_PASS;
+}
+
+#endif
@@ -326,8 +326,8 @@ Uint32 NAND_Init()
 	UARTSendData((Uint8 *) "Initializing NAND flash...\r\n", FALSE);
 	
 	// Alloc mem for temp pages
-	gNandTx = (Uint8 *) ubl_alloc_mem(MAX_PAGE_SIZE);
-	gNandRx = (Uint8 *) ubl_alloc_mem(MAX_PAGE_SIZE);
+	gNandTx = (Uint8 *) ubl_alloc_dma_mem(MAX_PAGE_SIZE);
+	gNandRx = (Uint8 *) ubl_alloc_dma_mem(MAX_PAGE_SIZE);
 	
 	// Set NAND flash base address
     gNandInfo.flashBase = (Uint32) &(__NANDFlash);
@@ -530,6 +530,7 @@ Uint32 NAND_ReadPage(Uint32 block, Uint32 page, Uint8 *dest) {
 				UARTSendData( (Uint8 *) "NAND ECC failure!\r\n", FALSE);
 				return E_FAIL;
 			}
+			gProgress.eccFixes++;
 		}
 	}
 	
@@ -604,19 +605,14 @@ Uint32 NAND_WritePage(Uint32 block, Uint32 page, Uint8 *src) {
 // **********************************************************
 Uint32 NAND_VerifyPage(Uint32 block, Uint32 page, Uint8* src, Uint8* dest)
 {
-    Uint32 i;
-
     if (NAND_ReadPage(block, page, dest) != E_PASS)
         return E_FAIL;
     
-    for (i=0; i< gNandInfo.bytesPerPage; i++)
+    // Check for data read errors
+    if (ubl_memcmp(src, dest, gNandInfo.bytesPerPage) != 0)
     {
-        // Check for data read errors
-        if (src[i] != dest[i])
-        {
-            UARTSendData("Data mismatch! Verification failed.", FALSE);
-            return E_FAIL;
-        }
+        UARTSendData("Data mismatch! Verification failed.", FALSE);
+        return E_FAIL;
     }
 	return E_PASS;
 }
@@ -657,6 +653,11 @@ Uint32 NAND_EraseBlocks(Uint32 startBlkNum, Uint32 blkCnt)
 		// verify the op succeeded by reading status from flash
         if (NAND_WaitForStatus(NAND_TIMEOUT) != E_PASS)
 			return E_FAIL;
+
+		// Report every 64 blocks, and at the end
+		gProgress.blocksErased++;
+		if ( ((i & 0x3F) == 0x3F) || (i == (blkCnt - 1)) )
+			UARTSendProgress();
 	}
 
 	return E_PASS;
@@ -733,6 +734,7 @@ Uint32 NAND_WriteHeaderAndData(NAND_BOOT *nandBoot, Uint8 *srcBuf) {
 	{
 		return E_FAIL; /* Block number is out of range */
 	}
+	gProgress.bytesTotal += (nandBoot->numPage + 1) * gNandInfo.bytesPerPage;
 
 NAND_WRITE_RETRY:
 	if (blockNum > endBlockNum)
@@ -747,6 +749,7 @@ NAND_WRITE_RETRY:
 	if (NAND_UnProtectBlocks(blockNum,numBlks) != E_PASS)
 	{
 		blockNum++;
+		gProgress.retries++;
 		UARTSendData((Uint8 *)"Unprotect failed\n", FALSE);
 		goto NAND_WRITE_RETRY;
 	}
@@ -755,6 +758,7 @@ NAND_WRITE_RETRY:
 	if (NAND_EraseBlocks(blockNum,numBlks) != E_PASS)
 	{
 		blockNum++;
+		gProgress.retries++;
 		UARTSendData((Uint8 *)"Erase failed\n", FALSE);
 		goto NAND_WRITE_RETRY;
 	}
@@ -778,6 +782,8 @@ NAND_WRITE_RETRY:
 	// Verify the page just written
 	if (NAND_VerifyPage(blockNum, 0, gNandTx, gNandRx) != E_PASS)
 		return E_FAIL;
+	gProgress.pagesWritten++;
+	gProgress.bytesWritten += gNandInfo.bytesPerPage;
 
 	count = 1; 
 
@@ -797,11 +803,15 @@ NAND_WRITE_RETRY:
 		
 		count++;
 		srcBuf += gNandInfo.bytesPerPage;
+		gProgress.pagesWritten++;
+		gProgress.bytesWritten += gNandInfo.bytesPerPage;
 		if (!(count & countMask))
 		{
 			blockNum++;
+			UARTSendProgress();
 		}
 	} while (count <= nandBoot->numPage);
+	UARTSendProgress();
 
 	NAND_ProtectBlocks();
 
@@ -42,9 +42,8 @@ Uint32 NAND_Copy() {
 	Uint32 block,page;
 	Uint32 readError = E_FAIL;
 	Bool failedOnceAlready = FALSE;
+	UBL_MEM_MARK rxBufMark;
 
-    // Maximum application size, in S-record form, is 16 MB
-	rxBuf = (Uint8*)ubl_alloc_mem((MAX_IMAGE_SIZE>>1));
 	blockNum = START_APP_BLOCK_NUM;
 
 	UARTSendData((Uint8 *)"Starting NAND Copy...\r\n", FALSE);
@@ -52,6 +51,10 @@ Uint32 NAND_Copy() {
 	// NAND Initialization
 	if (NAND_Init() != E_PASS)
 		return E_FAIL;
+
+    // Maximum application size, in S-record form, is 16 MB
+	ubl_mem_mark(&rxBufMark);
+	rxBuf = (Uint8*)ubl_alloc_mem((MAX_IMAGE_SIZE>>1));
     
 NAND_startAgain:
 	if (blockNum > END_APP_BLOCK_NUM)
@@ -99,7 +102,7 @@ NAND_startAgain:
 	    // Set the copy location to final run location
 		rxBuf = (Uint8 *)gNandBoot.ldAddress;
 		// Free temp memory rxBuf used to point to
-		set_current_mem_loc(get_current_mem_loc() - (MAX_IMAGE_SIZE>>1));
+		ubl_mem_release(&rxBufMark);
 	}
 
 NAND_retry:
@@ -137,19 +140,19 @@ NAND_retry_read:
 	/* Data is already copied to RAM, just set the entry point */
 	if(magicNum == UBL_MAGIC_SAFE)
 	{
-		// Or do the decode of the S-record 
-		if(SRecDecode( (Uint8 *)rxBuf, 
+		// Or do the decode of the S-record (or load of the ELF image)
+		if(ImageDecode( (Uint8 *)rxBuf, 
 		               gNandBoot.numPage * gNandInfo.bytesPerPage,
 					   (Uint32 *) &entryPoint2,
 		               (Uint32 *) &temp ) != E_PASS)
 		{
-		    UARTSendData("S-record decode failure.", FALSE);
+		    UARTSendData("Image decode failure.", FALSE);
 			return E_FAIL;
 		}
 		
 		if (gEntryPoint != entryPoint2)
 		{
-			UARTSendData("WARNING: S-record entrypoint does not match header entrypoint.\r\n", FALSE);
+			UARTSendData("WARNING: Image entrypoint does not match header entrypoint.\r\n", FALSE);
 			UARTSendData("WARNING: Using header entrypoint - results may be unexpected.\r\n", FALSE);
 		}
 	}
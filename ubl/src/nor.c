@@ -15,11 +15,13 @@
 #include "ubl.h"
 #include "dm644x.h"
 #include "uart.h"
+#include "util.h"
 #include "nor.h"
 
 //External and global static variables
 extern Uint32 __NORFlash;
 volatile NOR_INFO gNorInfo;
+NOR_BLOCK_MAP gNorBlockMap;
 
 // ----------------- Bus Width Agnostic commands -------------------
 VUint8 *flash_make_addr (Uint32 blkAddr, Uint32 offset)
@@ -109,26 +111,9 @@ void flash_write_databuffer(Uint32* address, void* data, Uint32 numBytes)
 
 Uint32 flash_verify_databuffer(Uint32 address, void* data, Uint32 numBytes)
 {
-    volatile FLASHPtr pAddr, pData;
-    VUint8* endAddress;
-		
-	pData.cp = (VUint8*) data;
-	pAddr.cp = (VUint8*) address;
-	endAddress =(VUint8*)(address+numBytes);
-	while (pAddr.cp < endAddress)
-	{
-	    switch (gNorInfo.busWidth)
-	    {
-	        case BUS_8BIT:
-                if ( (*pAddr.cp++) != (*pData.cp++) )
-                    return E_FAIL;
-                break;
-            case BUS_16BIT:
-                if ( (*pAddr.wp++) != (*pData.wp++) )
-                    return E_FAIL;
-                break;
-	    }
-    }
+    // The array is in read mode here, so the EMIF can fetch it by the word
+    if (ubl_memcmp((void *) address, data, numBytes) != 0)
+        return E_FAIL;
     return E_PASS;
 }
 
@@ -286,6 +271,7 @@ Uint32 NOR_Init()
     
     // Set width to 8 or 16
     gNorInfo.busWidth = (width)?BUS_16BIT:BUS_8BIT;
+    gNorInfo.unlockBypass = FALSE;
     
     // Perform CFI Query
     if (QueryCFI(gNorInfo.flashBase) == E_PASS)
@@ -316,7 +302,8 @@ Uint32 NOR_Init()
     {
         case AMD_BASIC_CMDSET:
         case AMD_EXT_CMDSET:
-            Flash_Erase          = &AMD_Erase;
+            Flash_EraseStart     = &AMD_EraseStart;
+            Flash_EraseWait      = &AMD_EraseWait;
             Flash_BufferWrite    = &AMD_BufferWrite;
             Flash_Write          = &AMD_Write;
             Flash_ID             = &AMD_ID;
@@ -324,7 +311,8 @@ Uint32 NOR_Init()
             break;
         case INTEL_BASIC_CMDSET:
         case INTEL_EXT_CMDSET:
-            Flash_Erase          = &Intel_Erase;
+            Flash_EraseStart     = &Intel_EraseStart;
+            Flash_EraseWait      = &Intel_EraseWait;
             Flash_BufferWrite    = &Intel_BufferWrite;
             Flash_Write          = &Intel_Write;
             Flash_ID             = &Intel_ID;
@@ -333,7 +321,8 @@ Uint32 NOR_Init()
         default:
             Flash_Write          = &Unsupported_Write;
             Flash_BufferWrite    = &Unsupported_BufferWrite;
-            Flash_Erase          = &Unsupported_Erase;
+            Flash_EraseStart     = &Unsupported_EraseStart;
+            Flash_EraseWait      = &Unsupported_EraseWait;
             Flash_ID             = &Unsupported_ID;
             UARTSendData("Unknown\r\n", FALSE);
             break;
@@ -375,6 +364,16 @@ Uint32 NOR_Init()
     UARTSendInt( gNorInfo.flashSize );
     UARTSendData("\r\n", FALSE);
     
+    // Build the erase block map used by all erase/program planning
+    if (NOR_BuildBlockMap() != E_PASS)
+    {
+        UARTSendData("NOR block map failed.\r\n", FALSE);
+        return E_FAIL;
+    }
+    UARTSendData("\tBlocks: 0x", FALSE);
+    UARTSendInt( gNorBlockMap.numBlocks );
+    UARTSendData("\r\n", FALSE);
+    
     return E_PASS;    
 }
 
@@ -449,7 +448,11 @@ Uint32 Unsupported_BufferWrite(Uint32 address, VUint8 data[], Uint32 length )
 {
     return E_FAIL;
 }
-Uint32 Unsupported_Erase(Uint32 address)
+Uint32 Unsupported_EraseStart(Uint32 blockNum, Uint32 endBlockNum, Uint32* lastBlock)
+{
+    return E_FAIL;
+}
+Uint32 Unsupported_EraseWait(Uint32 blockNum, Uint32 lastBlock)
 {
     return E_FAIL;
 }
@@ -565,17 +568,35 @@ Uint32 Intel_Lock_Status_Check()
 	return retval;
 }
 
-// Erase Block
-Uint32 Intel_Erase(VUint32 blkAddr)
+// Start erasing blocks blockNum..endBlockNum. Intel parts take one block
+// per erase, so only the lock bits are handled for the whole range here.
+Uint32 Intel_EraseStart(Uint32 blockNum, Uint32 endBlockNum, Uint32* lastBlock)
 {
-	Uint32 retval = E_PASS;
+	Uint32 i;
 	
-	// Clear Lock Bits
-	retval |= Intel_Clear_Lock(blkAddr);
+	// Clear Lock Bits up front (unless the block map says they are already clear)
+	for (i = blockNum; i <= endBlockNum; i++)
+	{
+		if ( !(gNorBlockMap.blockState[i] & NOR_BLK_UNLOCKED) )
+		{
+			if (Intel_Clear_Lock(NOR_BlockAddr(i)) != E_PASS)
+				return E_FAIL;
+			gNorBlockMap.blockState[i] |= NOR_BLK_UNLOCKED;
+		}
+	}
 	
 	// Send Erase commands
-	flash_write_cmd(blkAddr,0,INTEL_ERASE_CMD0);
-	flash_write_cmd(blkAddr,0,INTEL_ERASE_CMD1);
+	flash_write_cmd(NOR_BlockAddr(blockNum),0,INTEL_ERASE_CMD0);
+	flash_write_cmd(NOR_BlockAddr(blockNum),0,INTEL_ERASE_CMD1);
+	*lastBlock = blockNum;
+	
+	return E_PASS;
+}
+
+// Wait for the erase started by Intel_EraseStart
+Uint32 Intel_EraseWait(Uint32 blockNum, Uint32 lastBlock)
+{
+	Uint32 retval = E_PASS;
 	
 	// Wait until Erase operation complete
 	Intel_Wait_For_Status_Complete();
@@ -719,23 +740,47 @@ void AMD_Prefix_Commands()
     flash_write_cmd(gNorInfo.flashBase, AMD_CMD1_ADDR, AMD_CMD1);
 }
 
-// Erase Block
-Uint32 AMD_Erase(Uint32 blkAddr)
+// Start a multi-sector erase of blocks blockNum..endBlockNum. Extra sectors
+// are queued for as long as the sector erase timeout window is open (DQ3 clear).
+Uint32 AMD_EraseStart(Uint32 blockNum, Uint32 endBlockNum, Uint32* lastBlock)
 {
-    Uint32 retval = E_PASS;
+    Uint32 blkAddr = NOR_BlockAddr(blockNum);
 
     // Send commands
 	AMD_Prefix_Commands();
     flash_write_cmd(gNorInfo.flashBase, AMD_CMD2_ADDR, AMD_BLK_ERASE_SETUP_CMD);
     AMD_Prefix_Commands();
     flash_write_cmd(blkAddr, AMD_CMD2_ADDR, AMD_BLK_ERASE_CMD);
+    *lastBlock = blockNum;
+    
+    // Queue the following sectors while the window is still open
+    while ( (*lastBlock < endBlockNum) && !flash_issetsome(blkAddr, 0, BIT3) )
+    {
+        flash_write_cmd(NOR_BlockAddr(*lastBlock + 1), AMD_CMD2_ADDR, AMD_BLK_ERASE_CMD);
+        
+        // If the window closed around the command it may not have been taken
+        if ( flash_issetsome(blkAddr, 0, BIT3) )
+            break;
+        (*lastBlock)++;
+    }
+    
+    return E_PASS;
+}
+
+// Wait for the sectors queued by AMD_EraseStart
+Uint32 AMD_EraseWait(Uint32 blockNum, Uint32 lastBlock)
+{
+    Uint32 retval = E_PASS;
 	
-	// Poll DQ7 and DQ15 for status
-    while ( !flash_issetall(blkAddr, 0, BIT7) );
+	// Poll DQ7 and DQ15 for status (set once every queued sector is done)
+    while ( !flash_issetall(NOR_BlockAddr(blockNum), 0, BIT7) );
     
     // Check data 
-    if ( !flash_data_isequal(blkAddr, 0, AMD_BLK_ERASE_DONE) )
-        retval = E_FAIL;
+    for ( ; blockNum <= lastBlock; blockNum++)
+    {
+        if ( !flash_data_isequal(NOR_BlockAddr(blockNum), 0, AMD_BLK_ERASE_DONE) )
+            retval = E_FAIL;
+    }
 	
 	/* Flash Mode: Read Array */
     AMD_Soft_Reset_Flash();
@@ -748,8 +793,9 @@ Uint32 AMD_Write( Uint32 address, VUint32 data )
 {
 	Uint32 retval = E_PASS;
 	
-	// Send Commands
-	AMD_Prefix_Commands();
+	// Send Commands (unlock cycles are not needed in unlock bypass mode)
+	if (!gNorInfo.unlockBypass)
+	    AMD_Prefix_Commands();
     flash_write_cmd(gNorInfo.flashBase, AMD_CMD2_ADDR, AMD_PROG_CMD);
     flash_write_data(address, data);
 
@@ -774,8 +820,11 @@ Uint32 AMD_Write( Uint32 address, VUint32 data )
 		}
 	}
 	
-    // Return Read Mode
-	AMD_Soft_Reset_Flash();
+    // Return Read Mode (the device returns on its own in unlock bypass mode)
+	if (retval != E_PASS)
+	    AMD_Write_Buf_Abort_Reset_Flash();
+	else if (!gNorInfo.unlockBypass)
+	    AMD_Soft_Reset_Flash();
 	
 	// Verify the data.
 	if ( (retval == E_PASS) && ( flash_read_data(address, 0) != data) )
@@ -797,7 +846,8 @@ Uint32 AMD_BufferWrite(Uint32 address, VUint8 data[], Uint32 numBytes )
 	DiscoverBlockInfo(address, &blkSize, &blkAddress);
 			
 	// Write the Write Buffer Load command
-    AMD_Prefix_Commands();
+	if (!gNorInfo.unlockBypass)
+        AMD_Prefix_Commands();
     flash_write_cmd(blkAddress, 0, AMD_WRT_BUF_LOAD_CMD);
         
     //Establish correct shift value
@@ -843,7 +893,6 @@ Uint32 AMD_BufferWrite(Uint32 address, VUint8 data[], Uint32 numBytes )
 				{
 				    UARTSendData("Abort ocurred.\r\n",FALSE);
 					retval = E_FAIL;
-					AMD_Write_Buf_Abort_Reset_Flash ();
 				}
 				break;
 			}
@@ -851,7 +900,10 @@ Uint32 AMD_BufferWrite(Uint32 address, VUint8 data[], Uint32 numBytes )
 	}
 	
 	// Put chip back into read array mode.
-	AMD_Soft_Reset_Flash();
+	if (retval != E_PASS)
+	    AMD_Write_Buf_Abort_Reset_Flash();
+	else if (!gNorInfo.unlockBypass)
+	    AMD_Soft_Reset_Flash();
 	if (retval == E_PASS)
 	    retval = flash_verify_databuffer(startAddress,(void*)data, numBytes);
 	return retval;
@@ -860,36 +912,136 @@ Uint32 AMD_BufferWrite(Uint32 address, VUint8 data[], Uint32 numBytes )
 // AMD Write Buf Abort Reset Flash
 void AMD_Write_Buf_Abort_Reset_Flash()
 {
+	// Leave unlock bypass mode so the reset sequence is recognized
+	if (gNorInfo.unlockBypass)
+	    AMD_Unlock_Bypass_Exit();
+	
 	// Reset Flash to be in Read Array Mode
     AMD_Prefix_Commands();
     AMD_Soft_Reset_Flash();
 }
+
+// Enter unlock bypass mode - programs then only need the two-cycle sequence
+void AMD_Unlock_Bypass_Enter()
+{
+    AMD_Prefix_Commands();
+    flash_write_cmd(gNorInfo.flashBase, AMD_CMD2_ADDR, AMD_UNLOCK_BYPASS_CMD);
+    gNorInfo.unlockBypass = TRUE;
+}
+
+// Exit unlock bypass mode back to read array mode
+void AMD_Unlock_Bypass_Exit()
+{
+    flash_write_cmd(gNorInfo.flashBase, 0, AMD_UNLOCK_BYPASS_RST_CMD0);
+    flash_write_cmd(gNorInfo.flashBase, 0, AMD_UNLOCK_BYPASS_RST_CMD1);
+    gNorInfo.unlockBypass = FALSE;
+}
 //--------------------- End of AMD specific commands ------------------------
 
 
-// Get info on block address and sizes
-Uint32 DiscoverBlockInfo(Uint32 address,Uint32* blockSize, Uint32* blockAddr)
+// ------------------------- Erase Block Map --------------------------------
+
+// Build the block map from the CFI region info (called once from NOR_Init)
+Uint32 NOR_BuildBlockMap()
 {
     Int32 i;
-    Uint32 currRegionAddr, nextRegionAddr;
+    Uint32 shift;
+    
+    gNorBlockMap.regionAddr[0]  = gNorInfo.flashBase;
+    gNorBlockMap.regionBlock[0] = 0;
+    
+    for (i = 0; i < gNorInfo.numberRegions; i++)
+    {
+        // Block sizes are powers of two, so lookups can use shifts
+        shift = 0;
+        while ((gNorInfo.blockSize[i] >> shift) > 1)
+            shift++;
+        gNorBlockMap.blockShift[i] = shift;
         
-    currRegionAddr = (Uint32) gNorInfo.flashBase;
-    if ((address < currRegionAddr) || (address >= (currRegionAddr+gNorInfo.flashSize)))
+        gNorBlockMap.regionAddr[i+1]  = gNorBlockMap.regionAddr[i] + (gNorInfo.numberBlocks[i] << shift);
+        gNorBlockMap.regionBlock[i+1] = gNorBlockMap.regionBlock[i] + gNorInfo.numberBlocks[i];
+    }
+    gNorBlockMap.numBlocks = gNorBlockMap.regionBlock[gNorInfo.numberRegions];
+    
+    // Nothing is known about erase or lock state yet
+    gNorBlockMap.blockState = (Uint8 *) ubl_alloc_mem(gNorBlockMap.numBlocks);
+    if (gNorBlockMap.blockState == NULL)
+        return E_FAIL;
+    for (i = 0; i < gNorBlockMap.numBlocks; i++)
+        gNorBlockMap.blockState[i] = 0;
+    
+    return E_PASS;
+}
+
+// Binary search of the region table for the region holding an address
+static Uint32 NOR_FindRegion(Uint32 address)
+{
+    Uint32 lo = 0, hi = gNorInfo.numberRegions, mid;
+    
+    while ((hi - lo) > 1)
+    {
+        mid = (lo + hi) >> 1;
+        if (address < gNorBlockMap.regionAddr[mid])
+            hi = mid;
+        else
+            lo = mid;
+    }
+    return lo;
+}
+
+// Get the number of the block containing an address
+Uint32 NOR_AddrToBlock(Uint32 address, Uint32* blockNum)
+{
+    Uint32 region;
+    
+    if ( (address < gNorBlockMap.regionAddr[0]) ||
+         (address >= gNorBlockMap.regionAddr[gNorInfo.numberRegions]) )
     {
         return E_FAIL;
     }
     
-    for(i=0; i< (gNorInfo.numberRegions); i++)
+    region = NOR_FindRegion(address);
+    *blockNum = gNorBlockMap.regionBlock[region] +
+                ((address - gNorBlockMap.regionAddr[region]) >> gNorBlockMap.blockShift[region]);
+    return E_PASS;
+}
+
+// Get the start address of a block
+Uint32 NOR_BlockAddr(Uint32 blockNum)
+{
+    Uint32 region = 0;
+    
+    while (blockNum >= gNorBlockMap.regionBlock[region+1])
+        region++;
+    return gNorBlockMap.regionAddr[region] +
+           ((blockNum - gNorBlockMap.regionBlock[region]) << gNorBlockMap.blockShift[region]);
+}
+
+// Get the size of a block
+Uint32 NOR_BlockSize(Uint32 blockNum)
+{
+    Uint32 region = 0;
+    
+    while (blockNum >= gNorBlockMap.regionBlock[region+1])
+        region++;
+    return (0x1 << gNorBlockMap.blockShift[region]);
+}
+
+// Get info on block address and sizes
+Uint32 DiscoverBlockInfo(Uint32 address,Uint32* blockSize, Uint32* blockAddr)
+{
+    Uint32 region;
+    
+    if ( (address < gNorBlockMap.regionAddr[0]) ||
+         (address >= gNorBlockMap.regionAddr[gNorInfo.numberRegions]) )
     {
-        nextRegionAddr = currRegionAddr + (gNorInfo.blockSize[i] * gNorInfo.numberBlocks[i]);
-        if ( (currRegionAddr <= address) && (nextRegionAddr > address) )
-        {
-            *blockSize = gNorInfo.blockSize[i];
-            *blockAddr = address & (~((*blockSize) - 1));
-            break;
-        }
-        currRegionAddr = nextRegionAddr;
+        return E_FAIL;
     }
+    
+    region = NOR_FindRegion(address);
+    *blockSize = (0x1 << gNorBlockMap.blockShift[region]);
+    *blockAddr = gNorBlockMap.regionAddr[region] +
+                 ((address - gNorBlockMap.regionAddr[region]) & (~((*blockSize) - 1)));
     return E_PASS;
 }
 
@@ -901,42 +1053,73 @@ Uint32 NOR_GlobalErase()
     return NOR_Erase( (VUint32) gNorInfo.flashBase, (VUint32) gNorInfo.flashSize );
 }
 
-// Erase Flash Block
-Uint32 NOR_Erase(VUint32 start_address, VUint32 size)
+// Tighten the CS2 read timings once only reads (copy or execute-in-place)
+// remain.
+void NOR_SetReadTimings()
 {
-	VUint32 addr  = start_address;
-	VUint32 range = start_address + size;
-	Uint32 blockSize, blockAddr;
+    AEMIFSetReadTimings(NOR_READ_SETUP_NS, NOR_READ_ACCESS_NS, NOR_READ_OE_NS);
+}
+
+// Erase Flash Block.  Blocks already erased (and not written since) this
+// session are skipped, and the rest go to the flash in batches of up to
+// NOR_ERASE_BATCH blocks (AMD parts queue a batch as one multi-sector
+// erase, Intel parts take one block at a time).
+Uint32 NOR_Erase(Uint32 start_address, Uint32 size)
+{
+	Uint32 blockNum, endBlockNum, lastBlock, i;
 	
 	UARTSendData((Uint8 *)"Erasing the NOR Flash\r\n", FALSE);
 	
-   	while (addr < range)
-  	{
-	    if (DiscoverBlockInfo(addr, &blockSize, &blockAddr) != E_PASS)
-	    {
-	        UARTSendData((Uint8 *)"Address out of range", FALSE);
-	        return E_FAIL;
-	    }
+	if (size == 0)
+		return E_PASS;
+	
+	if ( (NOR_AddrToBlock(start_address, &blockNum) != E_PASS) ||
+	     (NOR_AddrToBlock(start_address + size - 1, &endBlockNum) != E_PASS) )
+	{
+		UARTSendData((Uint8 *)"Address out of range", FALSE);
+		return E_FAIL;
+	}
+	
+	while (1)
+	{
+		// Skip blocks already erased
+		while ( (blockNum <= endBlockNum) && (gNorBlockMap.blockState[blockNum] & NOR_BLK_ERASED) )
+			blockNum++;
+		if (blockNum > endBlockNum)
+			break;
 		
-		//Increment to the next block
-	    if ( (*Flash_Erase)(blockAddr) != E_PASS)
-	    {
-	        UARTSendData("Erase failure at block address 0x",FALSE);
-	        UARTSendInt(blockAddr);
-	        UARTSendData("\r\n", FALSE);
-	        return E_FAIL;
-	    }
-	    addr = blockAddr + blockSize;
-	    
-	    // Show status messages
-	    UARTSendData((Uint8 *)"Erased through 0x", FALSE);
-		UARTSendInt(addr);
+		// Batch up the run of blocks that still need erasing
+		lastBlock = blockNum;
+		while ( (lastBlock < endBlockNum) &&
+		        ((lastBlock - blockNum) < (NOR_ERASE_BATCH - 1)) &&
+		        !(gNorBlockMap.blockState[lastBlock + 1] & NOR_BLK_ERASED) )
+			lastBlock++;
+		
+		// The flash may take fewer blocks than asked; lastBlock says how many
+		if ( ((*Flash_EraseStart)(blockNum, lastBlock, &lastBlock) != E_PASS) ||
+		     ((*Flash_EraseWait)(blockNum, lastBlock) != E_PASS) )
+		{
+			UARTSendData("Erase failure at block address 0x",FALSE);
+			UARTSendInt(NOR_BlockAddr(blockNum));
+			UARTSendData("\r\n", FALSE);
+			return E_FAIL;
+		}
+		for (i = blockNum; i <= lastBlock; i++)
+			gNorBlockMap.blockState[i] |= NOR_BLK_ERASED;
+		gProgress.blocksErased += lastBlock - blockNum + 1;
+		
+		// Show status messages
+		UARTSendData((Uint8 *)"Erased through 0x", FALSE);
+		UARTSendInt(NOR_BlockAddr(lastBlock) + NOR_BlockSize(lastBlock));
 		UARTSendData((Uint8 *)"\r\n", FALSE);
-  	}
-
+		UARTSendProgress();
+		
+		blockNum = lastBlock + 1;
+	}
+	
 	UARTSendData((Uint8 *)"Erase Completed\r\n", FALSE);
-
-  	return(E_PASS);
+	
+	return E_PASS;
 }
 
 // NOR_WriteBytes
@@ -944,7 +1127,7 @@ Uint32 NOR_WriteBytes( Uint32 writeAddress,
 					   Uint32 numBytes,
 					   Uint32 readAddress)
 {
-	Uint32      blockSize, blockAddr;
+	Uint32      blockSize, blockEnd, blockNum, endBlockNum;
 	Int32		i;
 	Uint32      retval = E_PASS;
 
@@ -953,12 +1136,28 @@ Uint32 NOR_WriteBytes( Uint32 writeAddress,
 	// Make numBytes even if needed
 	if (numBytes & 0x00000001)
 		numBytes++;
+	
+	if (numBytes == 0)
+		return E_PASS;
+	gProgress.bytesTotal += numBytes;
 		
-    if (DiscoverBlockInfo(writeAddress, &blockSize, &blockAddr) != E_PASS)
+    if ( (NOR_AddrToBlock(writeAddress, &blockNum) != E_PASS) ||
+         (NOR_AddrToBlock(writeAddress + numBytes - 1, &endBlockNum) != E_PASS) )
     {
         UARTSendData((Uint8 *)"Address out of range", FALSE);
         return E_FAIL;
     }
+	
+	// Every block in the range is about to hold data
+	for (i = blockNum; i <= endBlockNum; i++)
+		gNorBlockMap.blockState[i] &= ~NOR_BLK_ERASED;
+	
+	blockSize = NOR_BlockSize(blockNum);
+	blockEnd  = NOR_BlockAddr(blockNum) + blockSize;
+	
+	// AMD parts program with the short command sequence for the whole image
+	if ( (gNorInfo.commandSet == AMD_BASIC_CMDSET) || (gNorInfo.commandSet == AMD_EXT_CMDSET) )
+		AMD_Unlock_Bypass_Enter();
 
 	while (numBytes > 0)
   	{
@@ -988,6 +1187,7 @@ Uint32 NOR_WriteBytes( Uint32 writeAddress,
 			else
 			{
 			    // Try normal writes as a backup
+			    gProgress.retries++;
 			    for(i = 0; i<(gNorInfo.bufferSize>>1); i++)
 				{
                     if ((*Flash_Write)(writeAddress, flash_read_data(readAddress,0) ) != E_PASS)
@@ -1014,20 +1214,29 @@ Uint32 NOR_WriteBytes( Uint32 writeAddress,
 	            UARTSendData((Uint8*) "NOR Write OK through 0x", FALSE);
 		        UARTSendInt(writeAddress);
 		        UARTSendData((Uint8*)"\r\n", FALSE);
-        		
-	            if (DiscoverBlockInfo(writeAddress, &blockSize, &blockAddr) != E_PASS)
-                {
-                    UARTSendData((Uint8 *)"Address out of range", FALSE);
-                    return E_FAIL;
-                }
+		        gProgress.bytesWritten = gProgress.bytesTotal - numBytes;
+		        UARTSendProgress();
+	        }
+	        
+	        // Step to the next block in the map when crossing into it
+	        if ( (numBytes > 0) && (writeAddress >= blockEnd) )
+	        {
+	            blockNum++;
+	            blockSize = NOR_BlockSize(blockNum);
+	            blockEnd += blockSize;
 	        }
 	    }
 	    else
 	    {
 		    UARTSendData((Uint8*) "NOR Write Failed...Aborting!\r\n", FALSE);
-		    return E_FAIL;
+		    break;
 		}
   	}
+  	
+  	// Back to normal command mode
+  	if (gNorInfo.unlockBypass)
+  	    AMD_Unlock_Bypass_Exit();
+  	
   	return retval;
 }
 
@@ -25,7 +25,6 @@ Uint32 NOR_Copy() {
 	volatile NOR_BOOT	*hdr = 0;
 	VUint32		*appStartAddr = 0;
 	VUint32		count = 0;
-	VUint32		*ramPtr = 0;
 	Uint32      blkSize, blkAddress;
 
 	UARTSendData((Uint8 *) "Starting NOR Copy...\r\n", FALSE);
@@ -47,21 +46,27 @@ Uint32 NOR_Copy() {
 	/* Set the Start Address */
 	appStartAddr = (Uint32 *)(((Uint8*)hdr) + sizeof(NOR_BOOT));
 
-	if(hdr->magicNum == UBL_MAGIC_BIN_IMG)
+	/* Only reads from here on, so use the fast read timings */
+	NOR_SetReadTimings();
+
+	/* Nothing to copy when the image runs from the flash itself */
+	if(hdr->magicNum == UBL_MAGIC_XIP_IMG)
 	{
-		ramPtr = (Uint32 *) hdr->ldAddress;
+		gEntryPoint = hdr->entryPoint;
+		return E_PASS;
+	}
 
+	if(hdr->magicNum == UBL_MAGIC_BIN_IMG)
+	{
 		/* Copy data to RAM */
-		for(count = 0; count < ((hdr->appSize + 3)/4); count ++)
-		{
-			ramPtr[count] = appStartAddr[count];
-		}
+		ubl_memcpy((void *) hdr->ldAddress, (void *) appStartAddr, ((hdr->appSize + 3) & ~0x3));
 		gEntryPoint = hdr->entryPoint;
 		/* Since our entry point is set, just return success */
 		return E_PASS;
 	}
 
-	if(SRecDecode((Uint8 *)appStartAddr, hdr->appSize, (Uint32 *)&gEntryPoint, (Uint32 *)&count ) != E_PASS)
+	/* S-record or ELF image, decoded straight from the flash */
+	if(ImageDecode((Uint8 *)appStartAddr, hdr->appSize, (Uint32 *)&gEntryPoint, (Uint32 *)&count ) != E_PASS)
 	{
 		return E_FAIL;
 	}
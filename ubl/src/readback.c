@@ -0,0 +1,257 @@
+/* --------------------------------------------------------------------------
+    FILE        : readback.c
+    PURPOSE     : Flash readback commands
+    PROJECT     : DaVinci User Boot-Loader and Flasher
+ ----------------------------------------------------------------------------- */
+
+#ifdef UBL_READBACK
+
+#include "ubl.h"
+#include "dm644x.h"
+#include "uart.h"
+#include "util.h"
+#include "readback.h"
+
+#ifdef UBL_NOR
+#include "nor.h"
+extern NOR_BLOCK_MAP gNorBlockMap;
+#endif
+
+#ifdef UBL_NAND
+#include "nand.h"
+extern NAND_INFO gNandInfo;
+#endif
+
+// ----------------- Flash access for the readback commands ------------------
+
+static Uint32 READBACK_Init(void)
+{
+#ifdef UBL_NOR
+    // Only reads follow, so the faster read timings can be used
+    if (NOR_Init() != E_PASS)
+        return E_FAIL;
+    NOR_SetReadTimings();
+    return E_PASS;
+#endif
+#ifdef UBL_NAND
+    return NAND_Init();
+#endif
+}
+
+static Uint32 READBACK_NumBlocks(void)
+{
+#ifdef UBL_NOR
+    return gNorBlockMap.numBlocks;
+#endif
+#ifdef UBL_NAND
+    return gNandInfo.numBlocks;
+#endif
+}
+
+// Read one block (ECC corrected for NAND) and give its layout in pages.  A
+// NOR block is split into READBACK_MAX_PAGES equal pages.
+static Uint32 READBACK_ReadBlock(Uint32 block, Uint8 *buf, Uint32 *pageSize, Uint32 *numPages)
+{
+#ifdef UBL_NOR
+    *pageSize = NOR_BlockSize(block) / READBACK_MAX_PAGES;
+    *numPages = READBACK_MAX_PAGES;
+    ubl_memcpy(buf, (void *) NOR_BlockAddr(block), NOR_BlockSize(block));
+    return E_PASS;
+#endif
+#ifdef UBL_NAND
+    Uint32 page, status = E_PASS;
+
+    *pageSize = gNandInfo.bytesPerPage;
+    *numPages = gNandInfo.pagesPerBlock;
+    for (page = 0; page < gNandInfo.pagesPerBlock; page++)
+    {
+        if (NAND_ReadPage(block, page, buf + (page * gNandInfo.bytesPerPage)) != E_PASS)
+            status = E_FAIL;
+    }
+    return status;
+#endif
+}
+
+static Uint32 READBACK_BlockBytes(Uint32 block)
+{
+#ifdef UBL_NOR
+    return NOR_BlockSize(block);
+#endif
+#ifdef UBL_NAND
+    return (gNandInfo.pagesPerBlock * gNandInfo.bytesPerPage);
+#endif
+}
+
+static Bool READBACK_IsErased(Uint32 *data, Uint32 numBytes)
+{
+    for (numBytes >>= 2; numBytes != 0; numBytes--)
+    {
+        if (*data++ != 0xFFFFFFFF)
+            return FALSE;
+    }
+    return TRUE;
+}
+
+// Get the block range (and flags) for a readback command from the host,
+// clipped to the end of the flash.  A count of zero means "to the end".
+static Uint32 READBACK_GetRange(Uint32 *startBlock, Uint32 *numBlocks, Uint32 *flags)
+{
+    Uint32 totalBlocks = READBACK_NumBlocks();
+
+    if ( UARTCheckSequence((Uint8*)"    ACK", TRUE) != E_PASS )
+        return E_FAIL;
+    if ( (UARTGetHexData(4, startBlock) != E_PASS) ||
+         (UARTGetHexData(4, numBlocks) != E_PASS)  ||
+         (UARTGetHexData(2, flags) != E_PASS) )
+        return E_FAIL;
+
+    if (*startBlock >= totalBlocks)
+    {
+        UARTSendData((Uint8*)"BADADDR", TRUE);
+        return E_FAIL;
+    }
+    if ( (*numBlocks == 0) || (*numBlocks > (totalBlocks - *startBlock)) )
+        *numBlocks = totalBlocks - *startBlock;
+
+    return E_PASS;
+}
+
+// ------------------------------ DUMP command -------------------------------
+
+// Stream a range of blocks to the host.  Each block goes out as
+//   "  BLOCK\0", then in hex: block number, status, CRC32 of the whole block,
+//   page size, number of pages and the erased page map,
+// followed by the raw bytes of every page not marked in the map (the map
+// stays empty unless the host asked for compression).
+Uint32 READBACK_Dump(void)
+{
+    Uint32 startBlock, numBlocks, flags, block;
+    Uint32 pageSize, numPages, page, status, i;
+    Uint32 erasedMap[READBACK_MAP_WORDS];
+    Uint8 *buf;
+    UBL_MEM_MARK mark;
+
+    if (READBACK_Init() != E_PASS)
+        return E_FAIL;
+
+    if ( UARTSendData((Uint8*)"SENDRNG", TRUE) != E_PASS )
+        return E_FAIL;
+    if (READBACK_GetRange(&startBlock, &numBlocks, &flags) != E_PASS)
+        return E_FAIL;
+
+    UARTSendData((Uint8*)"  BEGIN", TRUE);
+    UARTSendInt(numBlocks);
+
+    for (block = startBlock; block < (startBlock + numBlocks); block++)
+    {
+        ubl_mem_mark(&mark);
+        buf = (Uint8 *) ubl_alloc_mem(READBACK_BlockBytes(block));
+        if (buf == NULL)
+            return E_FAIL;
+
+        status = READBACK_BLK_OK;
+        if (READBACK_ReadBlock(block, buf, &pageSize, &numPages) != E_PASS)
+            status = READBACK_BLK_READ_ERR;
+
+        for (i = 0; i < READBACK_MAP_WORDS; i++)
+            erasedMap[i] = 0;
+        if (flags & READBACK_FLAG_COMPRESS)
+        {
+            for (page = 0; page < numPages; page++)
+            {
+                if (READBACK_IsErased((Uint32 *) (buf + (page * pageSize)), pageSize))
+                    erasedMap[page >> 5] |= (1 << (page & 0x1F));
+            }
+        }
+
+        UARTSendData((Uint8*)"  BLOCK", TRUE);
+        UARTSendInt(block);
+        UARTSendInt(status);
+        UARTSendInt(CRC32Calc(0, buf, (pageSize * numPages)));
+        UARTSendInt(pageSize);
+        UARTSendInt(numPages);
+        for (i = 0; i < ((numPages + 31) >> 5); i++)
+            UARTSendInt(erasedMap[i]);
+
+        for (page = 0; page < numPages; page++)
+        {
+            if ( !(erasedMap[page >> 5] & (1 << (page & 0x1F))) &&
+                 (UARTSendBytes(buf + (page * pageSize), pageSize) != E_PASS) )
+                return E_FAIL;
+        }
+
+        ubl_mem_release(&mark);
+    }
+
+    return UARTSendData((Uint8*)"   DONE", TRUE);
+}
+
+// ----------------------------- VERIFY command ------------------------------
+
+// Check a range of blocks against CRCs from the host without sending the
+// data.  The UBL lists the size of every block in the range after SENDCRC so
+// the host can compute the expected CRC32s from its image, takes them back
+// after an ACK, and reports each block that differs as "MISMTCH" with its
+// number and actual CRC.  DONE carries the number of mismatches.
+Uint32 READBACK_Verify(void)
+{
+    Uint32 startBlock, numBlocks, flags, i;
+    Uint32 pageSize, numPages, crc, numBad = 0;
+    Uint32 *expected;
+    Uint8 *buf;
+    UBL_MEM_MARK mark;
+
+    if (READBACK_Init() != E_PASS)
+        return E_FAIL;
+
+    if ( UARTSendData((Uint8*)"SENDRNG", TRUE) != E_PASS )
+        return E_FAIL;
+    if (READBACK_GetRange(&startBlock, &numBlocks, &flags) != E_PASS)
+        return E_FAIL;
+
+    expected = (Uint32 *) ubl_alloc_mem(numBlocks * sizeof(Uint32));
+    if (expected == NULL)
+        return E_FAIL;
+
+    UARTSendData((Uint8*)"SENDCRC", TRUE);
+    UARTSendInt(numBlocks);
+    for (i = 0; i < numBlocks; i++)
+        UARTSendInt(READBACK_BlockBytes(startBlock + i));
+
+    if ( UARTCheckSequence((Uint8*)"    ACK", TRUE) != E_PASS )
+        return E_FAIL;
+    for (i = 0; i < numBlocks; i++)
+    {
+        if (UARTGetHexData(4, &expected[i]) != E_PASS)
+            return E_FAIL;
+    }
+
+    for (i = 0; i < numBlocks; i++)
+    {
+        ubl_mem_mark(&mark);
+        buf = (Uint8 *) ubl_alloc_mem(READBACK_BlockBytes(startBlock + i));
+        if (buf == NULL)
+            return E_FAIL;
+
+        // A block that cannot be read correctly cannot match
+        if (READBACK_ReadBlock(startBlock + i, buf, &pageSize, &numPages) != E_PASS)
+            crc = ~expected[i];
+        else
+            crc = CRC32Calc(0, buf, (pageSize * numPages));
+
+        if (crc != expected[i])
+        {
+            UARTSendData((Uint8*)"MISMTCH", TRUE);
+            UARTSendInt(startBlock + i);
+            UARTSendInt(crc);
+            numBad++;
+        }
+
+        ubl_mem_release(&mark);
+    }
+
+    UARTSendData((Uint8*)"   DONE", TRUE);
+    return UARTSendInt(numBad);
+}
+
+#endif
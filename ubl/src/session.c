@@ -0,0 +1,110 @@
+/* --------------------------------------------------------------------------
+    FILE        : session.c
+    PURPOSE     : Resumable UART transfer sessions
+    PROJECT     : DaVinci User Boot-Loader and Flasher
+ ----------------------------------------------------------------------------- */
+
+#include "ubl.h"
+#include "dm644x.h"
+#include "uart.h"
+#include "util.h"
+#include "session.h"
+
+static UBL_SESSION * const gSession = (UBL_SESSION *) SESSION_ADDR;
+
+// Protect the record so a stale or overwritten one is never trusted
+static void SESSION_Seal(void)
+{
+    gSession->magicNum  = SESSION_MAGIC;
+    gSession->recordCrc = CRC32Calc(0, (Uint8 *) gSession, (sizeof(UBL_SESSION) - sizeof(Uint32)));
+}
+
+// Check whether the record describes the data this header announces
+static Bool SESSION_Matches(UART_ACK_HEADER *ackHeader)
+{
+    if ( (gSession->magicNum != SESSION_MAGIC) ||
+         (gSession->recordCrc != CRC32Calc(0, (Uint8 *) gSession, (sizeof(UBL_SESSION) - sizeof(Uint32)))) )
+        return FALSE;
+
+    return ( (gSession->imageMagic   == ackHeader->magicNum)     &&
+             (gSession->appStartAddr == ackHeader->appStartAddr) &&
+             (gSession->srecByteCnt  == ackHeader->srecByteCnt)  &&
+             (gSession->srecAddr     == ackHeader->srecAddr)     &&
+             (gSession->bytesDone    <= ackHeader->srecByteCnt) );
+}
+
+// Offer the host the first incomplete block of an interrupted transfer of
+// the same data, along with the CRC32 of what was received before it.  The
+// host answers with the offset it will send from: the one offered, or zero
+// to start over.
+Uint32 SESSION_Negotiate(UART_ACK_HEADER *ackHeader, Uint32 *offset)
+{
+    Uint32 hostOffset;
+
+    // The buffer may have changed since the record was sealed (an image
+    // loaded in place, or a later allocation), so only offer what still
+    // matches the recorded CRC
+    if ( !SESSION_Matches(ackHeader) ||
+         (CRC32Calc(0, (Uint8 *) ackHeader->srecAddr, gSession->bytesDone) != gSession->dataCrc) )
+    {
+        gSession->imageMagic   = ackHeader->magicNum;
+        gSession->appStartAddr = ackHeader->appStartAddr;
+        gSession->srecByteCnt  = ackHeader->srecByteCnt;
+        gSession->srecAddr     = ackHeader->srecAddr;
+        gSession->bytesDone    = 0;
+        gSession->dataCrc      = 0;
+        SESSION_Seal();
+    }
+
+    if ( UARTSendData((Uint8*)" RESUME", TRUE) != E_PASS )
+        return E_FAIL;
+    UARTSendInt(gSession->bytesDone);
+    UARTSendInt(gSession->dataCrc);
+
+    if ( UARTCheckSequence((Uint8*)"    ACK", TRUE) != E_PASS )
+        return E_FAIL;
+    if ( UARTGetHexData(4, &hostOffset) != E_PASS )
+        return E_FAIL;
+
+    if (hostOffset != gSession->bytesDone)
+    {
+        if (hostOffset != 0)
+            return E_FAIL;
+        gSession->bytesDone = 0;
+        gSession->dataCrc   = 0;
+        SESSION_Seal();
+    }
+
+    *offset = hostOffset;
+    return E_PASS;
+}
+
+// Receive the data from offset on, recording each block as it completes
+Uint32 SESSION_RecvData(UART_ACK_HEADER *ackHeader, Uint32 offset)
+{
+    Uint8  *buf = (Uint8 *) ackHeader->srecAddr;
+    Uint32 numBytes;
+
+    while (offset < ackHeader->srecByteCnt)
+    {
+        numBytes = ackHeader->srecByteCnt - offset;
+        if (numBytes > SESSION_BLOCK_SIZE)
+            numBytes = SESSION_BLOCK_SIZE;
+
+        if ( UARTRecvData(numBytes, buf + offset) != E_PASS )
+            return E_FAIL;
+
+        gSession->dataCrc   = CRC32Calc(gSession->dataCrc, buf + offset, numBytes);
+        offset += numBytes;
+        gSession->bytesDone = offset;
+        SESSION_Seal();
+    }
+
+    return E_PASS;
+}
+
+// Nothing is left to resume once the command has gone through
+void SESSION_End(void)
+{
+    gSession->magicNum = 0;
+}
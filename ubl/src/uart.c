@@ -13,18 +13,39 @@
 #include "uart.h"
 #include "util.h"
 #include "ubl.h"
+#include "session.h"
+#include "elf.h"
+#include "container.h"
 
 extern VUint32 gMagicFlag,gBootCmd;
 extern VUint32 gDecodedByteCount,gSrecByteCount;
 
-// Send specified number of bytes 
+// Command frame last received, and how many of its headers have been used
+static UART_CMD_FRAME gCmdFrame;
+static Uint32 gFrameHeader;
+
+// Flash progress of the current phase, updated by the NAND and NOR code
+UART_PROGRESS gProgress;
+static Uint32 gProgressTick;
+
+// Send a string (optionally with its terminating null)
 Uint32 UARTSendData(Uint8* seq, Bool includeNull)
 {
-	Uint32 status = 0;
-    Int32 i,numBytes;
-	Uint32 timerStatus = 1;
+	Int32 numBytes;
 	
 	numBytes = includeNull?(GetStringLen(seq)+1):(GetStringLen(seq));
+	if (numBytes < 0)
+		numBytes = 0;
+	
+	return UARTSendBytes(seq, numBytes);
+}
+
+// Send specified number of bytes 
+Uint32 UARTSendBytes(Uint8* seq, Uint32 numBytes)
+{
+	Uint32 status = 0;
+    Uint32 i;
+	Uint32 timerStatus = 1;
 	
 	for(i=0;i<numBytes;i++) {
 		/* Enable Timer one time */
@@ -62,6 +83,32 @@ Uint32 UARTSendInt(Uint32 value)
 	return UARTSendData(seq, FALSE);
 }
 
+// Tell the host which phase of the command has been reached, so it can
+// time them (see UART_PHASE_*)
+Uint32 UARTSendPhase(Uint32 phase)
+{
+	// Progress counts start over with each phase
+	ubl_memset(&gProgress, 0, sizeof(gProgress));
+	gProgressTick = TIMER1->TIM12;
+	
+	if (UARTSendData((Uint8*)"  PHASE", TRUE) != E_PASS)
+		return E_FAIL;
+	return UARTSendInt(phase);
+}
+
+// Send the flash progress so far (see UART_PROGRESS)
+Uint32 UARTSendProgress()
+{
+	Uint32 now = TIMER1->TIM12;
+	
+	gProgress.ticks = now - gProgressTick;
+	gProgressTick = now;
+	
+	if (UARTSendData((Uint8*)"PROGRES", TRUE) != E_PASS)
+		return E_FAIL;
+	return UARTSendBytes((Uint8*)&gProgress, sizeof(gProgress));
+}
+
 // Get string length by finding null terminating char
 Int32 GetStringLen(Uint8* seq)
 {
@@ -130,22 +177,19 @@ Uint32 UARTCheckSequence(Uint8* seq, Bool includeNull)
 Uint32 UARTGetHexData(Uint32 numBytes, Uint32* data) {
     
     Uint32 i,j;
-    Uint32 temp[8];
+    Uint8 temp[8];
     Uint32 timerStatus = 1, status = 0;
-    Uint32 numLongs, numAsciiChar, shift;
+    Uint32 numLongs, numAsciiChar;
     
     if(numBytes == 2) {
         numLongs = 1;
         numAsciiChar = 4;
-        shift = 12;
     } else {
         numLongs = numBytes/4;
         numAsciiChar = 8;
-        shift = 28;
     }
 
     for(i=0;i<numLongs;i++) {
-        data[i] = 0;
         for(j=0;j<numAsciiChar;j++) {
             /* Enable Timer one time */
             TIMER0Start();
@@ -157,57 +201,85 @@ Uint32 UARTGetHexData(Uint32 numBytes, Uint32* data) {
             if(timerStatus == 0)
                 return E_TIMEOUT;
 
-            /* Converting ascii to Hex*/
-            temp[j] = ((UART0->RBR)&0xFF)-48;
-            if(temp[j] > 22)/* To support lower case a,b,c,d,e,f*/
-               temp[j] = temp[j]-39;
-            else if(temp[j]>9)/* To support Upper case A,B,C,D,E,F*/
-               temp[j] = temp[j]-7;
+            temp[j] = (UART0->RBR)&0xFF;
 
             /* Checking for bit 1,2,3,4 for reception Error *///1E->1C
             if( ( (UART0->LSR)&(0x1C) ) != 0)
                 return E_FAIL;
-
-            data[i] |= (temp[j]<<(shift-(j*4)));
         }
+
+        /* Converting ascii to Hex*/
+        if (HexToWord(temp, numAsciiChar, &data[i]) != E_PASS)
+            return E_FAIL;
     }
     return E_PASS;
 }
 
+// Get the command, either as "    CMD" + 8 hex characters or as a binary
+// command frame (see UART_CMD_FRAME)
 Uint32 UARTGetCMD(Uint32* bootCmd)
 {
-    if(UARTCheckSequence((Uint8*)"    CMD", TRUE) != E_PASS)
-    {
+    Uint8 seq[8];
+
+    gCmdFrame.numHeaders = 0;
+    gFrameHeader = 0;
+
+    if (UARTRecvData(8, seq) != E_PASS)
+        return E_FAIL;
+
+    if (ubl_memcmp(seq, "    CMD", 8) == 0)
+        return UARTGetHexData(4, bootCmd);
+
+    if (ubl_memcmp(seq, "  FRAME", 8) != 0)
+        return E_FAIL;
+
+    if (UARTRecvData(sizeof(gCmdFrame), (Uint8*) &gCmdFrame) != E_PASS)
         return E_FAIL;
-    }
 
-    if(UARTGetHexData(4,bootCmd) != E_PASS)
+    if ( (gCmdFrame.crc != CRC32Calc(0, (Uint8*) &gCmdFrame, (sizeof(gCmdFrame) - sizeof(Uint32)))) ||
+         (gCmdFrame.numHeaders > UART_FRAME_MAX_HEADERS) )
     {
+        gCmdFrame.numHeaders = 0;
+        UARTSendData((Uint8*)" BADCRC", TRUE);
         return E_FAIL;
     }
 
+    *bootCmd = gCmdFrame.bootCmd;
     return E_PASS;
 }
 
 Uint32 UARTGetHeaderAndData(UART_ACK_HEADER* ackHeader)
 {
-    Uint32 error = E_FAIL;
+    Uint32 error = E_FAIL, offset = 0;
+    UART_FRAME_HEADER *header;
 
-    // Send ACK command
-    error = UARTCheckSequence((Uint8*)"    ACK", TRUE);
-    if(error != E_PASS)
+    if (gFrameHeader < gCmdFrame.numHeaders)
     {
-        return E_FAIL;
+        // The header came with the command frame
+        header = &(gCmdFrame.header[gFrameHeader++]);
+        ackHeader->magicNum     = header->magicNum;
+        ackHeader->appStartAddr = header->appStartAddr;
+        ackHeader->srecByteCnt  = header->byteCnt;
+        ackHeader->flags        = header->flags;
     }
-
-    // Get the ACK header elements
-    error =  UARTGetHexData( 4, (Uint32 *) &(ackHeader->magicNum)     );
-    error |= UARTGetHexData( 4, (Uint32 *) &(ackHeader->appStartAddr) );
-    error |= UARTGetHexData( 4, (Uint32 *) &(ackHeader->srecByteCnt)  );
-    error |= UARTCheckSequence((Uint8*)"0000", FALSE);
-    if(error != E_PASS)
+    else
     {
-        return E_FAIL;
+        // Send ACK command
+        error = UARTCheckSequence((Uint8*)"    ACK", TRUE);
+        if(error != E_PASS)
+        {
+            return E_FAIL;
+        }
+
+        // Get the ACK header elements
+        error =  UARTGetHexData( 4, (Uint32 *) &(ackHeader->magicNum)     );
+        error |= UARTGetHexData( 4, (Uint32 *) &(ackHeader->appStartAddr) );
+        error |= UARTGetHexData( 4, (Uint32 *) &(ackHeader->srecByteCnt)  );
+        error |= UARTGetHexData( 2, (Uint32 *) &(ackHeader->flags)        );
+        if(error != E_PASS)
+        {
+            return E_FAIL;
+        }
     }
 
     // Verify that the S-record's size is appropriate
@@ -218,8 +290,11 @@ Uint32 UARTGetHeaderAndData(UART_ACK_HEADER* ackHeader)
     }
 
     // Verify application start address is in RAM (lower 16bit of appStartAddr also used 
-    // to hold UBL entry point if this header describes a UBL)
-    if( (ackHeader->appStartAddr < RAM_START_ADDR) || (ackHeader->appStartAddr > RAM_END_ADDR) )
+    // to hold UBL entry point if this header describes a UBL), or in the NOR window for
+    // an execute-in-place image
+    if( ( (ackHeader->appStartAddr < RAM_START_ADDR) || (ackHeader->appStartAddr > RAM_END_ADDR) ) &&
+        ( (ackHeader->magicNum != UBL_MAGIC_XIP_IMG) ||
+          (ackHeader->appStartAddr < NOR_START_ADDR) || (ackHeader->appStartAddr > NOR_END_ADDR) ) )
     {
         UARTSendData((Uint8*)"BADADDR", TRUE);/*trailing /0 will come along*/
         return E_FAIL;
@@ -228,12 +303,21 @@ Uint32 UARTGetHeaderAndData(UART_ACK_HEADER* ackHeader)
     // Allocate storage for S-record
     ackHeader->srecAddr = (Uint32) ubl_alloc_mem(ackHeader->srecByteCnt);
 
+    // Let a host that supports it pick up an interrupted transfer
+    if ( (ackHeader->flags & UART_FLAG_RESUME) &&
+         (SESSION_Negotiate(ackHeader, &offset) != E_PASS) )
+        return E_FAIL;
+
     // Send BEGIN command
     if ( UARTSendData((Uint8*)"  BEGIN", TRUE) != E_PASS )
         return E_FAIL;
 
     // Receive the data over UART
-    if ( UARTRecvData(ackHeader->srecByteCnt, (Uint8*)(ackHeader->srecAddr)) != E_PASS )
+    if (ackHeader->flags & UART_FLAG_RESUME)
+        error = SESSION_RecvData(ackHeader, offset);
+    else
+        error = UARTRecvData(ackHeader->srecByteCnt, (Uint8*)(ackHeader->srecAddr));
+    if (error != E_PASS)
     {
         UARTSendData((Uint8*)"\r\nUART Receive Error\r\n", FALSE);
         return E_FAIL;
@@ -243,13 +327,24 @@ Uint32 UARTGetHeaderAndData(UART_ACK_HEADER* ackHeader)
     if ( UARTSendData((Uint8*)"   DONE", TRUE) != E_PASS )
         return E_FAIL;
 
-    // Now decode the S-record
-    if ( SRecDecode(    (Uint8 *)(ackHeader->srecAddr),
+    // Such images are loaded segment by segment, so binAddr and binByteCnt
+    // are their entry point and load size rather than one flat binary
+#ifdef UBL_ELF
+    if (ELF_IsImage((Uint8 *)(ackHeader->srecAddr)))
+        ackHeader->flags |= UART_FLAG_SEGMENTED;
+#endif
+#ifdef UBL_CONTAINER
+    if (CONTAINER_IsImage((Uint8 *)(ackHeader->srecAddr)))
+        ackHeader->flags |= UART_FLAG_SEGMENTED;
+#endif
+
+    // Now decode the S-record (or load the ELF image)
+    if ( ImageDecode(   (Uint8 *)(ackHeader->srecAddr),
                         ackHeader->srecByteCnt,
                         &(ackHeader->binAddr),
                         &(ackHeader->binByteCnt) ) != E_PASS )
     {
-        UARTSendData((Uint8*)"\r\nS-record Decode Failed.\r\n", FALSE);
+        UARTSendData((Uint8*)"\r\nImage Decode Failed.\r\n", FALSE);
         return E_FAIL;
     }
 
@@ -14,6 +14,8 @@
 #include "uart.h"
 #include "util.h"
 #include "dm644x.h"
+#include "session.h"
+#include "readback.h"
 
 #ifdef UBL_NOR
 #include "nor.h"
@@ -47,6 +49,10 @@ void UART_Boot(void) {
 	Uint32             bootCmd;
 
 UART_tryAgain:
+	// Nothing allocated by a failed flash boot or a failed earlier attempt
+	// is needed any more, so start again with empty arenas
+	ubl_mem_init();
+
 	// Initialize UART and TIMER
 	//UARTInit();
 	waitloop(100);
@@ -91,6 +97,7 @@ UART_tryAgain:
 			NOR_Init();
 
 			// Erasing the Flash
+			UARTSendPhase(UART_PHASE_BURN_UBL);
 			NOR_Erase(gNorInfo.flashBase, ackHeader.binByteCnt);
 
 			// Write binary UBL to NOR flash
@@ -100,12 +107,16 @@ UART_tryAgain:
 			if ( UARTSendData((Uint8*)"SENDAPP", TRUE) != E_PASS)
 				goto UART_tryAgain;
 
-			// Get the application header and data
+			// Get the application header and data (the old application is only
+			// erased once all of the new one has arrived)
 			if (UARTGetHeaderAndData(&ackHeader) != E_PASS)
 			{
 				goto UART_tryAgain;
 			}
 
+			DiscoverBlockInfo( (gNorInfo.flashBase + UBL_IMAGE_SIZE), &blkSize, &blkAddress );
+	        baseAddress =  (blkAddress + blkSize);
+
 			// Determine whether to use binary or srec
 			if (bootCmd == UBL_MAGIC_NOR_BIN_BURN) 
 			{
@@ -117,22 +128,45 @@ UART_tryAgain:
 				dataByteCnt = ackHeader.srecByteCnt;
 				dataAddr = ackHeader.srecAddr;				
 			}
+
+			// Segments of an ELF or container image are scattered over memory,
+			// so only the image as received can be stored
+			if ( (bootCmd == UBL_MAGIC_NOR_BIN_BURN) && (ackHeader.flags & UART_FLAG_SEGMENTED) )
+			{
+				UARTSendData((Uint8 *) "ELF and container images need an s-record burn.\r\n", FALSE);
+				goto UART_tryAgain;
+			}
 	
+			// An execute-in-place image runs where it is stored, so it must be a
+			// binary linked for the flash right after its header
+			if ( (ackHeader.magicNum == UBL_MAGIC_XIP_IMG) &&
+			     ( (bootCmd != UBL_MAGIC_NOR_BIN_BURN) ||
+			       (ackHeader.appStartAddr < (baseAddress + sizeof(norBoot))) ||
+			       (ackHeader.appStartAddr >= (baseAddress + sizeof(norBoot) + dataByteCnt)) ) )
+			{
+				UARTSendData((Uint8 *) "XIP image must be binary and linked at 0x", FALSE);
+				UARTSendInt(baseAddress + sizeof(norBoot));
+				UARTSendData((Uint8 *) "\r\n", FALSE);
+				goto UART_tryAgain;
+			}
+
 			// Erase the NOR flash where header and data will go
-			DiscoverBlockInfo( (gNorInfo.flashBase + UBL_IMAGE_SIZE), &blkSize, &blkAddress );
-	        baseAddress =  (blkAddress + blkSize);
+			UARTSendPhase(UART_PHASE_BURN_APP);
 			NOR_Erase( baseAddress, (dataByteCnt + sizeof(norBoot)) );
 
 			norBoot.magicNum = ackHeader.magicNum;			//MagicFlag for Application (binary or safe)
 			norBoot.appSize = dataByteCnt;					//Bytes of application (either srec or binary)
 			norBoot.entryPoint = ackHeader.appStartAddr;	//Value from ACK header
 			norBoot.ldAddress = ackHeader.binAddr;			//Should be same as AppStartAddr
+			if (norBoot.magicNum == UBL_MAGIC_XIP_IMG)
+				norBoot.ldAddress = baseAddress + sizeof(norBoot);	//Runs from the flash
 
 			// Write the NOR_BOOT header to the flash
 			NOR_WriteBytes( baseAddress, sizeof(norBoot), (Uint32) &norBoot);
 
 			// Write the application data to the flash
 			NOR_WriteBytes((baseAddress + sizeof(norBoot)), dataByteCnt, dataAddr);
+			UARTSendPhase(UART_PHASE_END);
 
 			// Set the entry point for code execution to the newly copied binary UBL
 			gEntryPoint = gNorInfo.flashBase;
@@ -152,12 +186,14 @@ UART_tryAgain:
 				goto UART_tryAgain;
 			
 			// Erasing the Flash
+			UARTSendPhase(UART_PHASE_BURN_APP);
 			if ( NOR_Erase(gNorInfo.flashBase, ackHeader.binByteCnt) != E_PASS )
 			    goto UART_tryAgain;
 
 			// Write the actual application to the flash
 			if ( NOR_WriteBytes(gNorInfo.flashBase, ackHeader.binByteCnt, ackHeader.binAddr) != E_PASS )
 			    goto UART_tryAgain;
+			UARTSendPhase(UART_PHASE_END);
 
 			// Set the entry point for code execution
 			gEntryPoint = gNorInfo.flashBase;
@@ -169,6 +205,7 @@ UART_tryAgain:
 			NOR_Init();
 
 			// Erasing the Flash
+			UARTSendPhase(UART_PHASE_ERASE);
 			if (NOR_GlobalErase() != E_PASS)
 			{
 				UARTSendData((Uint8 *)"\r\nErase failed.\r\n", FALSE);
@@ -177,6 +214,7 @@ UART_tryAgain:
 			{
 				UARTSendData((Uint8 *)"\r\nErase completed successfully.\r\n", FALSE);
 			}
+			UARTSendPhase(UART_PHASE_END);
 
 			// Set the entry point for code execution
 			// Go to reset in this case since no code was downloaded
@@ -228,6 +266,7 @@ UART_tryAgain:
 			// Write header to page 0 of block 1(or up to block 5)
 			// Write the UBL to the same block, starting at page 1 (since blocks are 16k)
 			UARTSendData((Uint8 *) "Writing UBL to NAND flash\r\n", FALSE);
+			UARTSendPhase(UART_PHASE_BURN_UBL);
 			if (NAND_WriteHeaderAndData(&nandBoot, (Uint8 *) ackHeader.binAddr) != E_PASS)
 			    goto UART_tryAgain;
 
@@ -253,6 +292,14 @@ UART_tryAgain:
 				dataAddr = ackHeader.binAddr;
 			}
 
+			// Segments of an ELF or container image are scattered over memory,
+			// so only the image as received can be stored
+			if ( (bootCmd == UBL_MAGIC_NAND_BIN_BURN) && (ackHeader.flags & UART_FLAG_SEGMENTED) )
+			{
+				UARTSendData((Uint8 *) "ELF and container images need an s-record burn.\r\n", FALSE);
+				goto UART_tryAgain;
+			}
+
 			// Rely on the host applciation to send over the right magic number (safe or bin)
 			nandBoot.magicNum = ackHeader.magicNum;
 
@@ -277,8 +324,10 @@ UART_tryAgain:
 
 			// Nand Burn of application data
 			UARTSendData((Uint8 *) "Writing APP to NAND flash\r\n", FALSE);
+			UARTSendPhase(UART_PHASE_BURN_APP);
 			if (NAND_WriteHeaderAndData(&nandBoot, (Uint8 *) dataAddr) != E_PASS)
 			    goto UART_tryAgain;
+			UARTSendPhase(UART_PHASE_END);
 
 			// Set the entry point to nowhere, since there isn't an appropriate binary image to run */
 			gEntryPoint = 0x0;
@@ -297,6 +346,7 @@ UART_tryAgain:
 			NAND_UnProtectBlocks(1,gNandInfo.numBlocks - 1);
 
 			// Erase all the pages of the device
+			UARTSendPhase(UART_PHASE_ERASE);
 			if (NAND_EraseBlocks(1,(gNandInfo.numBlocks - 1)) != E_PASS)
 			{
 				UARTSendData((Uint8 *)"Erase failed.\r\n", FALSE);
@@ -306,6 +356,7 @@ UART_tryAgain:
 			{
 				UARTSendData((Uint8 *)"Erase completed successfully.\r\n", FALSE);
 			}
+			UARTSendPhase(UART_PHASE_END);
 			            
 			// Protect the device
 			NAND_ProtectBlocks();
@@ -315,6 +366,26 @@ UART_tryAgain:
 			gEntryPoint = 0x0; 
 			break;
 		}
+#endif
+#ifdef UBL_READBACK
+		case UBL_MAGIC_DUMP:
+		{
+			if (READBACK_Dump() != E_PASS)
+				goto UART_tryAgain;
+
+			// Go to reset in this case since no code was downloaded
+			gEntryPoint = 0x0;
+			break;
+		}
+		case UBL_MAGIC_VERIFY:
+		{
+			if (READBACK_Verify() != E_PASS)
+				goto UART_tryAgain;
+
+			// Go to reset in this case since no code was downloaded
+			gEntryPoint = 0x0;
+			break;
+		}
 #endif
 		default:
 		{
@@ -330,5 +401,8 @@ UART_tryAgain:
 			break;
 		}
 	}	/* end switch statement */
+
+	// The command went through, so there is nothing left to resume
+	SESSION_End();
 }
 
@@ -39,6 +39,8 @@
 #endif
 
 Uint32 gEntryPoint;
+Uint32 gMachType;       // Passed in r1 to the entry point (for a Linux kernel)
+Uint32 gAtagAddr;       // Passed in r2 to the entry point (for a Linux kernel)
 BootMode gBootMode;
 
 void selfcopy()
@@ -91,12 +93,16 @@ void boot()
 	register Uint32* stackpointer asm ("sp");	
 	stackpointer = &(__topstack);
 	
+	// Clear .bss (__bss_start and __bss_end defined in linker script)
+	extern Uint32 __bss_start, __bss_end;
+	ubl_memset(&__bss_start, 0, ((Uint32) &__bss_end - (Uint32) &__bss_start));
+	
     // Call to main code
     main();
     
     // Jump to entry point
 	APPEntry = (void*) gEntryPoint;
-    (*APPEntry)();	
+    (*APPEntry)(0, gMachType, gAtagAddr);	
 }
 
 Int32 main(void)
@@ -115,14 +121,20 @@ Int32 main(void)
 	// Platform Initialization
 	DM644xInit();
 
-	// Set RAM pointer to beginning of RAM space
-	set_current_mem_loc(0);
+	// Set RAM pointers to beginning of RAM space
+	ubl_mem_init();
+
+	// No kernel boot arguments unless a container sets them up
+	gMachType = 0;
+	gAtagAddr = 0;
 
 	// Send some information to host
     UARTSendData((Uint8 *) "TI UBL Version: ",FALSE);
     UARTSendData((Uint8 *) UBL_VERSION_STRING,FALSE);
     UARTSendData((Uint8 *) ", Flash type: ", FALSE);
     UARTSendData((Uint8 *) UBL_FLASH_TYPE, FALSE);
+    UARTSendData((Uint8 *) ", DSP/DDR clocks: ", FALSE);
+    UARTSendData((Uint8 *) gClockProfile->name, FALSE);
 	UARTSendData((Uint8 *) "\r\nBooting PSP Boot Loader\r\nPSPBootMode = ",FALSE);
 	
 	/* Select Boot Mode */
@@ -187,6 +199,7 @@ UARTBOOT:	UART_Boot();
 	// Disabling UART timeout timer
     while((UART0->LSR & 0x40) == 0 );
 	TIMER0->TCR = 0x00000000;
+	TIMER1->TCR = 0x00000000;
 
 	return E_PASS;    
 }
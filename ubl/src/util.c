@@ -13,20 +13,22 @@
 #include "dm644x.h"
 #include "uart.h"
 #include "util.h"
+#include "elf.h"
+#include "container.h"
+#include "session.h"
 
 // Memory allocation stuff
+// DDRMem holds two arenas: general scratch (MAX_IMAGE_SIZE bytes, word
+// aligned) followed by cache line aligned buffers for DMA (DMA_MEM_SIZE)
 static VUint32 current_mem_loc;
+static VUint32 current_dma_loc;
 VUint8 DDRMem[0] __attribute__((section (".ddrram")));;
 
 // DDR Memory allocation routines (for storing large data)
-Uint32 get_current_mem_loc()
+void ubl_mem_init()
 {
-	return current_mem_loc;
-}
-
-void set_current_mem_loc(Uint32 value)
-{
-	current_mem_loc = value;
+	current_mem_loc = 0;
+	current_dma_loc = MAX_IMAGE_SIZE;
 }
 
 void *ubl_alloc_mem (Uint32 size)
@@ -48,41 +50,154 @@ void *ubl_alloc_mem (Uint32 size)
 	return cPtr;
 }
 
+void *ubl_alloc_dma_mem (Uint32 size)
+{
+	void *cPtr;
+	Uint32 size_temp;
+
+	// Whole cache lines only, so no line is shared with other data
+	size_temp = (size + DMA_MEM_ALIGN - 1) & ~(DMA_MEM_ALIGN - 1);
+	
+	if((current_dma_loc + size_temp) > (MAX_IMAGE_SIZE + DMA_MEM_SIZE))
+	{
+		return 0;
+	}
+
+	cPtr = (void *) (DDRMem + current_dma_loc);
+	current_dma_loc += size_temp;
+
+	return cPtr;
+}
+
+// Remember the current allocation point of both regions
+void ubl_mem_mark(UBL_MEM_MARK *mark)
+{
+	mark->scratch = current_mem_loc;
+	mark->dma = current_dma_loc;
+}
+
+// Free everything allocated since the mark was taken (an older mark
+// releases the scopes nested inside it as well)
+void ubl_mem_release(UBL_MEM_MARK *mark)
+{
+	if (mark->scratch < current_mem_loc)
+		current_mem_loc = mark->scratch;
+	if (mark->dma < current_dma_loc)
+		current_dma_loc = mark->dma;
+}
+
+#if defined(UBL_ELF) || defined(UBL_CONTAINER)
+
+// DDR the UBL still needs while it loads an image: the DMA arena and the
+// session record above it
+#define LOAD_RESERVED_START	(RAM_START_ADDR + MAX_IMAGE_SIZE)
+#define LOAD_RESERVED_END	(SESSION_ADDR + sizeof(UBL_SESSION))
+
+// Check that a segment load target neither wraps around the address space
+// nor reaches into the DDR the UBL still needs
+Bool ubl_load_target_ok(Uint32 addr, Uint32 numBytes)
+{
+	if (numBytes == 0)
+		return TRUE;
+	if (numBytes > ~addr)
+		return FALSE;
+	return ( (addr >= LOAD_RESERVED_END) || ((addr + numBytes) <= LOAD_RESERVED_START) );
+}
+
+// Segments are copied forward out of the image, so one that lands on the
+// image would overwrite data not read yet.  If [loadStart, loadEnd) meets
+// the image, move the image to just above loadEnd (and the reserved DDR).
+Uint32 ubl_stage_image(Uint8 **imageAddr, Uint32 imageByteCnt, Uint32 loadStart, Uint32 loadEnd)
+{
+	Uint32 src = (Uint32) *imageAddr;
+	Uint32 stage;
+
+	if ( (loadStart >= loadEnd) || (loadStart >= (src + imageByteCnt)) || (src >= loadEnd) )
+		return E_PASS;
+
+	stage = (loadEnd > LOAD_RESERVED_END) ? loadEnd : LOAD_RESERVED_END;
+	stage = (stage + DMA_MEM_ALIGN - 1) & ~(DMA_MEM_ALIGN - 1);
+	if ( (stage > RAM_END_ADDR) || (imageByteCnt > (RAM_END_ADDR - stage + 1)) ||
+	     ((src + imageByteCnt) > stage) )
+		return E_FAIL;
+
+	ubl_memcpy((void *) stage, *imageAddr, imageByteCnt);
+	*imageAddr = (Uint8 *) stage;
+	return E_PASS;
+}
+
+#endif
+
 
 // S-record Decode stuff
-Uint32 GetHexData(Uint8 *src, Uint32 numBytes, Uint8* seq)
+
+// Hex nibble value of the characters '0' to 'f', the only ones that can be
+// hex digits (HEX_INVALID for the others in that range)
+#define XX HEX_INVALID
+const Uint8 gHexTable[HEX_TABLE_SIZE] = {
+	 0,  1,  2,  3,  4,  5,  6,  7,  8,  9, XX, XX, XX, XX, XX, XX,	// 0x30
+	XX, 10, 11, 12, 13, 14, 15, XX, XX, XX, XX, XX, XX, XX, XX, XX,	// 0x40
+	XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,	// 0x50
+	XX, 10, 11, 12, 13, 14, 15					// 0x60
+};
+#undef XX
+
+// Convert numChars (up to 8) hex characters into one word, most significant first
+Uint32 HexToWord(Uint8 *src, Uint32 numChars, Uint32 *value)
 {
-	Uint32 i;
-	Uint8 temp[2];
-	Uint32 checksum = 0;
+	Uint32 result = 0, check = 0, nibble, index;
 
-	for(i=0;i<numBytes;i++)
+	while (numChars--)
 	{
-		/* Converting ascii to Hex*/
-		temp[0] = *src++ - 48;
-		temp[1] = *src++ - 48;
-		if(temp[0] > 22)/* To support lower case a,b,c,d,e,f*/
-		   temp[0] = temp[0]-39;
-		else if(temp[0]>9)/* To support Upper case A,B,C,D,E,F*/
-		   temp[0] = temp[0]-7;
-		if(temp[1] > 22)/* To support lower case a,b,c,d,e,f*/
-		   temp[1] = temp[1]-39;
-		else if(temp[1]>9)/* To support Upper case A,B,C,D,E,F*/
-		   temp[1] = temp[1]-7;
-	
-		seq[i] = (temp[0] << 4) | temp[1];
-		checksum += seq[i];
+		// Characters below '0' wrap round to a large index
+		index = (Uint32) (*src++) - '0';
+		nibble = (index < HEX_TABLE_SIZE) ? gHexTable[index] : HEX_INVALID;
+		check |= nibble;
+		result = (result << 4) | nibble;
+	}
+	*value = result;
+
+	// Any invalid character leaves bits set above the nibble
+	return (check & ~0xF) ? E_FAIL : E_PASS;
+}
 
+// Convert numBytes bytes of hex text to dest, eight characters at a time,
+// adding each byte to *checksum
+Uint32 HexToBytes(Uint8 *src, Uint32 numBytes, Uint8 *dest, Uint32 *checksum)
+{
+	Uint32 word, retval = E_PASS;
+
+	for ( ; numBytes >= 4; numBytes -= 4, src += 8, dest += 4)
+	{
+		retval |= HexToWord(src, 8, &word);
+		dest[0] = (Uint8) (word >> 24);
+		dest[1] = (Uint8) (word >> 16);
+		dest[2] = (Uint8) (word >> 8);
+		dest[3] = (Uint8) word;
+		*checksum += dest[0] + dest[1] + dest[2] + dest[3];
+	}
+	for ( ; numBytes > 0; numBytes--, src += 2, dest++)
+	{
+		retval |= HexToWord(src, 2, &word);
+		*dest = (Uint8) word;
+		*checksum += word;
 	}
-	return checksum;
+
+	return retval;
+}
+
+// Both add the bytes they decode to *checksum and fail on bad hex
+Uint32 GetHexData(Uint8 *src, Uint32 numBytes, Uint8* seq, Uint32 *checksum)
+{
+	return HexToBytes(src, numBytes, seq, checksum);
 }
 
-Uint32 GetHexAddr(Uint8 *src, Uint32* addr)
+Uint32 GetHexAddr(Uint8 *src, Uint32* addr, Uint32 *checksum)
 {
-	Uint32 checksum;
-	checksum = GetHexData(src,4,(Uint8 *)addr);
-	*addr = ENDIAN_SWAP(*addr);
-	return checksum;
+	Uint32 retval = HexToWord(src, 8, addr);
+
+	*checksum += ((*addr) >> 24) + (((*addr) >> 16) & 0xFF) + (((*addr) >> 8) & 0xFF) + ((*addr) & 0xFF);
+	return retval;
 }
 
 Uint32 SRecDecode(Uint8 *srecAddr, Uint32 srecByteCnt, Uint32 *binAddr, Uint32 *binByteCnt)
@@ -92,6 +207,7 @@ Uint32 SRecDecode(Uint8 *srecAddr, Uint32 srecByteCnt, Uint32 *binAddr, Uint32 *
 	Uint32		dstAddr;
 	Uint32		totalCnt;
 	Uint32		checksum;
+	Uint32		error;
 
 	totalCnt = 0;
 	index = 0;
@@ -104,7 +220,9 @@ Uint32 SRecDecode(Uint8 *srecAddr, Uint32 srecByteCnt, Uint32 *binAddr, Uint32 *
 	
 	index += 2;
 	// Read the length of S0 record & Ignore that many bytes
-	GetHexData (&srecAddr[index], 1, &cnt);
+	checksum = 0;
+	if (GetHexData (&srecAddr[index], 1, &cnt, &checksum) != E_PASS)
+		goto SREC_badRecord;
 	index += (cnt * 2) + 2;     // Ignore the count and checksum
 
 	while(index <= srecByteCnt)
@@ -114,25 +232,32 @@ Uint32 SRecDecode(Uint8 *srecAddr, Uint32 srecByteCnt, Uint32 *binAddr, Uint32 *
 		{
 			index += 2;
 		
-			checksum = GetHexData (srecAddr+index, 1, &cnt);
+			checksum = 0;
+			error  = GetHexData (srecAddr+index, 1, &cnt, &checksum);
 			index += 2;
 
-			checksum += GetHexAddr(srecAddr+index, &dstAddr);
+			error |= GetHexAddr(srecAddr+index, &dstAddr, &checksum);
 			index += 8;
 			
 			// Eliminate the Address 4 Bytes and checksum
+			if ( (error != E_PASS) || (cnt < 5) )
+				goto SREC_badRecord;
 			cnt -=5;	
 
 			// Read cnt bytes to the to the determined destination address
-			checksum += GetHexData (srecAddr+index, cnt, (Uint8 *)dstAddr);
+			if ( HexToBytes(srecAddr+index, cnt, (Uint8 *)dstAddr, &checksum) != E_PASS )
+			{
+				UARTSendData((Uint8 *) "S-record decode invalid hex data.\r\n", FALSE);
+				return E_FAIL;
+			}
 			index += (cnt << 1);
 			dstAddr += cnt;
 			totalCnt += cnt;
 
-			/* Skip Checksum */
-			GetHexData (srecAddr+index, 1, &cnt);
+			// The checksum byte brings the sum of the record's bytes to 0xFF
+			error = GetHexData (srecAddr+index, 1, &cnt, &checksum);
 			index += 2;
-			if ( cnt != (Uint8)((~checksum) & 0xFF) )
+			if ( (error != E_PASS) || ((checksum & 0xFF) != 0xFF) )
 			{
 				UARTSendData((Uint8 *) "S-record decode checksum failure.\r\n", FALSE);
 				return E_FAIL;
@@ -144,16 +269,20 @@ Uint32 SRecDecode(Uint8 *srecAddr, Uint32 srecByteCnt, Uint32 *binAddr, Uint32 *
 		{
 			index += 2;
 
-			GetHexData (&srecAddr[index], 1, (Uint8 *)&cnt);
+			checksum = 0;
+			error = GetHexData (&srecAddr[index], 1, &cnt, &checksum);
 			index += 2;
 
-			if (cnt == 5)
+			if ( (error == E_PASS) && (cnt == 5) )
 			{
-				GetHexAddr (&srecAddr[index], binAddr);
+				error  = GetHexAddr (&srecAddr[index], binAddr, &checksum);
 				index +=8;
 
-				// Skip over the checksum
+				// Check the checksum
+				error |= GetHexData (&srecAddr[index], 1, &cnt, &checksum);
 				index += 2;
+				if ( (error != E_PASS) || ((checksum & 0xFF) != 0xFF) )
+					goto SREC_badRecord;
 				// We are at the end of the S-record, so we can exit while loop
 				break;
 			}
@@ -176,8 +305,125 @@ Uint32 SRecDecode(Uint8 *srecAddr, Uint32 srecByteCnt, Uint32 *binAddr, Uint32 *
 	}	//end while
 	*binByteCnt = totalCnt;
 	return E_PASS;
+
+SREC_badRecord:
+	UARTSendData((Uint8 *) "S-record decode invalid record.\r\n", FALSE);
+	return E_FAIL;
+}
+
+
+// Standard (reflected, inverted) CRC-32 a nibble at a time, to keep the
+// table small. Pass 0 to start, or a previous result to continue.
+static const Uint32 crc32Table[16] = {
+	0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC,
+	0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+	0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+	0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+};
+
+Uint32 CRC32Calc(Uint32 crc, Uint8 *data, Uint32 numBytes)
+{
+	crc = ~crc;
+	while (numBytes--)
+	{
+		crc ^= *data++;
+		crc = (crc >> 4) ^ crc32Table[crc & 0xF];
+		crc = (crc >> 4) ^ crc32Table[crc & 0xF];
+	}
+	return ~crc;
+}
+
+// Decode a downloaded or stored image: ELF32 executables and boot
+// containers (when built in) are loaded segment by segment, anything else
+// is taken to be an S-record
+Uint32 ImageDecode(Uint8 *imageAddr, Uint32 imageByteCnt, Uint32 *binAddr, Uint32 *binByteCnt)
+{
+#ifdef UBL_CONTAINER
+	if (CONTAINER_IsImage(imageAddr))
+		return CONTAINER_Load(imageAddr, imageByteCnt, binAddr, binByteCnt);
+#endif
+
+#ifdef UBL_ELF
+	if (ELF_IsImage(imageAddr))
+		return ELF_Load(imageAddr, imageByteCnt, binAddr, binByteCnt);
+#endif
+
+	return SRecDecode(imageAddr, imageByteCnt, binAddr, binByteCnt);
 }
 
+// Copy memory.  When source and destination share word alignment the bulk
+// of the copy goes through BurstCopy, one 32-byte cache line per LDM/STM
+// pair; otherwise it falls back to bytes.
+void *ubl_memcpy(void *dest, const void *src, Uint32 numBytes)
+{
+	Uint8 *d = (Uint8 *) dest;
+	const Uint8 *s = (const Uint8 *) src;
+
+	if ( (((Uint32) d ^ (Uint32) s) & 0x3) == 0 )
+	{
+		while ( (((Uint32) d & 0x3) != 0) && (numBytes != 0) )
+		{
+			*d++ = *s++;
+			numBytes--;
+		}
+		BurstCopy((Uint32 *) d, (Uint32 *) s, (numBytes >> 2));
+		d += (numBytes & ~0x3);
+		s += (numBytes & ~0x3);
+		numBytes &= 0x3;
+	}
+
+	while (numBytes--)
+		*d++ = *s++;
+
+	return dest;
+}
+
+// Compare memory, returning zero when equal and otherwise the difference
+// of the first mismatching bytes.  Co-aligned buffers are compared four
+// words per iteration and only the mismatching word is rescanned by byte.
+Int32 ubl_memcmp(const void *buf1, const void *buf2, Uint32 numBytes)
+{
+	const Uint8 *p1 = (const Uint8 *) buf1;
+	const Uint8 *p2 = (const Uint8 *) buf2;
+	const Uint32 *w1, *w2;
+
+	if ( (((Uint32) p1 ^ (Uint32) p2) & 0x3) == 0 )
+	{
+		while ( (((Uint32) p1 & 0x3) != 0) && (numBytes != 0) )
+		{
+			if (*p1 != *p2)
+				return (*p1 - *p2);
+			p1++; p2++;
+			numBytes--;
+		}
+
+		w1 = (const Uint32 *) p1;
+		w2 = (const Uint32 *) p2;
+		while ( (numBytes >= 16) &&
+		        (w1[0] == w2[0]) && (w1[1] == w2[1]) &&
+		        (w1[2] == w2[2]) && (w1[3] == w2[3]) )
+		{
+			w1 += 4; w2 += 4;
+			numBytes -= 16;
+		}
+		while ( (numBytes >= 4) && (*w1 == *w2) )
+		{
+			w1++; w2++;
+			numBytes -= 4;
+		}
+		p1 = (const Uint8 *) w1;
+		p2 = (const Uint8 *) w2;
+	}
+
+	while (numBytes--)
+	{
+		if (*p1 != *p2)
+			return (*p1 - *p2);
+		p1++; p2++;
+	}
+
+	return 0;
+}
 
 // Simple wait loop - comes in handy.
 void waitloop(Uint32 loopcnt)